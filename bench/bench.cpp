@@ -0,0 +1,500 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include <exception>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include "math/vector.hpp"
+#include "math/transform.hpp"
+
+#include "graphics/context.hpp"
+
+#include "world/level.hpp"
+#include "world/maze.hpp"
+#include "world/room.hpp"
+
+// renders a level headless along a fixed camera path and reports frame times,
+// nothing depends on the wall clock so two runs draw exactly the same frames
+
+struct options_t {
+    std::string level = "room";
+    unsigned int seed = 1;
+    int size = 15;
+    unsigned int width = 683;
+    unsigned int height = 384;
+    unsigned int frames = 600;
+    unsigned int warmup = 30;
+    std::string path;
+    std::string format = "csv";
+    std::string out;
+    bool threaded = true;
+    bool visibility_buffer = false;
+    bool wireframe = false;
+    unsigned int block_size = 8;
+    depth_format_t depth_format = depth_format_t::float32;
+};
+
+// the stages of a frame, total is their sum
+enum stage_t {
+    stage_update,  // level and player update
+    stage_clear,   // clear
+    stage_render,  // scene traversal, transform, clipping, triangle setup and binning,
+                   // single threaded triangles are rasterized right away and counted here
+    stage_flush,   // tile rasterization and the visibility buffer resolve, only the
+                   // resolve when single threaded
+    stage_finish,  // clearing the color of pixels nothing was drawn to
+    stage_total,
+    num_stages
+};
+
+const char * stage_names[num_stages] = { "update", "clear", "render", "flush", "finish", "total" };
+
+const char * depth_format_name(depth_format_t format) {
+    switch (format) {
+        case depth_format_t::reversed_float32: return "reversed_float32";
+        case depth_format_t::unorm16: return "unorm16";
+        default: return "float32";
+    }
+}
+
+// pipeline counters reported as averages per frame
+const struct {
+    const char * name;
+    uint64_t pipeline_stats_t::* counter;
+} pipeline_counters[] = {
+    { "triangles_submitted", &pipeline_stats_t::triangles_submitted },
+    { "triangles_rejected", &pipeline_stats_t::triangles_rejected },
+    { "clipped_away", &pipeline_stats_t::clipped_away },
+    { "clipped_to_one", &pipeline_stats_t::clipped_to_one },
+    { "clipped_to_two", &pipeline_stats_t::clipped_to_two },
+    { "clipped_to_more", &pipeline_stats_t::clipped_to_more },
+    { "triangles_backface", &pipeline_stats_t::triangles_backface },
+    { "triangles_degenerate", &pipeline_stats_t::triangles_degenerate },
+    { "triangles_rasterized", &pipeline_stats_t::triangles_rasterized },
+    { "blocks_hiz_culled", &pipeline_stats_t::blocks_hiz_culled },
+    { "pixels_tested", &pipeline_stats_t::pixels_tested },
+    { "depth_passed", &pipeline_stats_t::depth_passed },
+    { "depth_failed", &pipeline_stats_t::depth_failed },
+    { "texture_samples", &pipeline_stats_t::texture_samples }
+};
+
+struct camera_pose_t {
+    vec_t<float> eye, at;
+};
+
+// keys held by the scripted player, each for a number of frames, the script loops
+struct script_step_t {
+    SDL_Keycode key;
+    unsigned int frames;
+};
+
+const script_step_t player_script[] = {
+    { SDLK_w, 90 }, { SDLK_d, 47 }, { SDLK_w, 60 }, { SDLK_a, 94 },
+    { SDLK_w, 120 }, { SDLK_d, 141 }, { SDLK_s, 45 }, { SDLK_a, 70 }
+};
+
+// the player moves in steps of a 60 hz frame no matter how long frames take
+const float time_step = 1.0f / 60.0f;
+
+void usage() {
+    std::cerr <<
+        "usage: bench [options]\n"
+        "  --level room|maze      level to render (room)\n"
+        "  --seed n               maze seed (1)\n"
+        "  --size n               maze width and height in tiles (15)\n"
+        "  --resolution wxh       render target size (683x384)\n"
+        "  --frames n             measured frames (600)\n"
+        "  --warmup n             frames rendered before measuring (30)\n"
+        "  --path file            camera path to replay, one 'eye_x eye_y eye_z at_x at_y at_z' per\n"
+        "                         line and frame, instead of the scripted player\n"
+        "  --format csv|json      report format (csv), pipeline counters are only reported in json\n"
+        "  --out file             write the report to file instead of stdout\n"
+        "  --single-threaded      rasterize every triangle on the calling thread as it is drawn,\n"
+        "                         rasterization then counts as render and flush only resolves\n"
+        "  --visibility-buffer    deferred texturing\n"
+        "  --wireframe            draw edges only\n"
+        "  --block-size n         coarse block size, 0 disables it (8)\n"
+        "  --depth float32|reversed_float32|unorm16\n";
+}
+
+options_t parse_options(int argc, char ** argv) {
+    options_t options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+
+            return argv[++i];
+        };
+
+        if (arg == "--level") {
+            options.level = value();
+        } else if (arg == "--seed") {
+            options.seed = std::stoul(value());
+        } else if (arg == "--size") {
+            options.size = std::stoi(value());
+        } else if (arg == "--resolution") {
+            const std::string resolution = value();
+            if (std::sscanf(resolution.c_str(), "%ux%u", &options.width, &options.height) != 2) {
+                throw std::runtime_error("invalid resolution: " + resolution);
+            }
+        } else if (arg == "--frames") {
+            options.frames = std::stoul(value());
+        } else if (arg == "--warmup") {
+            options.warmup = std::stoul(value());
+        } else if (arg == "--path") {
+            options.path = value();
+        } else if (arg == "--format") {
+            options.format = value();
+        } else if (arg == "--out") {
+            options.out = value();
+        } else if (arg == "--single-threaded") {
+            options.threaded = false;
+        } else if (arg == "--visibility-buffer") {
+            options.visibility_buffer = true;
+        } else if (arg == "--wireframe") {
+            options.wireframe = true;
+        } else if (arg == "--block-size") {
+            options.block_size = std::stoul(value());
+        } else if (arg == "--depth") {
+            const std::string format = value();
+
+            if (format == "float32") {
+                options.depth_format = depth_format_t::float32;
+            } else if (format == "reversed_float32") {
+                options.depth_format = depth_format_t::reversed_float32;
+            } else if (format == "unorm16") {
+                options.depth_format = depth_format_t::unorm16;
+            } else {
+                throw std::runtime_error("unknown depth format: " + format);
+            }
+        } else if (arg == "--help") {
+            usage();
+            std::exit(0);
+        } else {
+            usage();
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    if (options.level != "room" && options.level != "maze") {
+        throw std::runtime_error("unknown level: " + options.level);
+    }
+
+    if (options.format != "csv" && options.format != "json") {
+        throw std::runtime_error("unknown report format: " + options.format);
+    }
+
+    if (options.frames == 0 || options.width == 0 || options.height == 0) {
+        throw std::runtime_error("frames and resolution must not be zero");
+    }
+
+    return options;
+}
+
+std::vector<camera_pose_t> load_path(const std::string & filename) {
+    std::ifstream file(filename);
+
+    if (!file) {
+        throw std::runtime_error("failed to open camera path: " + filename);
+    }
+
+    std::vector<camera_pose_t> path;
+    std::string line;
+
+    for (unsigned int number = 1; std::getline(file, line); ++number) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream stream(line);
+        camera_pose_t pose = { vec_t<float>(0.0f), vec_t<float>(0.0f) };
+
+        if (!(stream >> pose.eye[0] >> pose.eye[1] >> pose.eye[2] >> pose.at[0] >> pose.at[1] >> pose.at[2])) {
+            throw std::runtime_error("invalid camera pose in " + filename + " on line " + std::to_string(number));
+        }
+
+        path.push_back(pose);
+    }
+
+    if (path.empty()) {
+        throw std::runtime_error("camera path is empty: " + filename);
+    }
+
+    return path;
+}
+
+void send_key(Level & level, SDL_Keycode key, bool pressed) {
+    SDL_Event event = {};
+    event.type = pressed ? SDL_KEYDOWN : SDL_KEYUP;
+    event.key.keysym.sym = key;
+    level.event(event);
+}
+
+// feeds the level the key presses and releases of the scripted player for a frame
+void play_script(Level & level, unsigned int frame) {
+    const unsigned int num_steps = sizeof(player_script) / sizeof(player_script[0]);
+
+    unsigned int script_frames = 0;
+    for (const script_step_t & step : player_script) {
+        script_frames += step.frames;
+    }
+
+    frame %= script_frames;
+
+    // the last key is released when the script starts over
+    if (frame == 0) {
+        send_key(level, player_script[num_steps - 1].key, false);
+    }
+
+    for (const script_step_t & step : player_script) {
+        if (frame == 0) {
+            send_key(level, step.key, true);
+            return;
+        }
+
+        if (frame < step.frames) {
+            return;
+        }
+
+        if (frame == step.frames) {
+            send_key(level, step.key, false);
+        }
+
+        frame -= step.frames;
+    }
+}
+
+uint64_t checksum(GraphicsContext & context) {
+    // fnv-1a over the visible pixels
+    uint64_t hash = 1469598103934665603ull;
+    const uint32_t * pixels = context.get_color_buffer();
+
+    for (unsigned int y = 0; y < context.get_height(); ++y) {
+        for (unsigned int x = 0; x < context.get_width(); ++x) {
+            hash = (hash ^ pixels[x + y * context.get_pitch()]) * 1099511628211ull;
+        }
+    }
+
+    return hash;
+}
+
+struct summary_t {
+    double mean, p50, p99, min, max;
+};
+
+summary_t summarize(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+
+    // nearest rank percentiles
+    auto percentile = [&](double p) {
+        std::size_t rank = (std::size_t)std::ceil(p * times.size());
+        return times[std::max<std::size_t>(rank, 1) - 1];
+    };
+
+    double sum = 0.0;
+    for (double time : times) {
+        sum += time;
+    }
+
+    return { sum / times.size(), percentile(0.5), percentile(0.99), times.front(), times.back() };
+}
+
+void report(std::ostream & stream, const options_t & options, const std::vector<double> (&times)[num_stages], const pipeline_stats_t & stats, uint64_t hash) {
+    char hash_text[17];
+    std::snprintf(hash_text, sizeof(hash_text), "%016llx", (unsigned long long)hash);
+
+    stream.setf(std::ios::fixed);
+    stream.precision(4);
+
+    if (options.format == "csv") {
+        stream << "stage,mean_ms,p50_ms,p99_ms,min_ms,max_ms\n";
+
+        for (unsigned int stage = 0; stage < num_stages; ++stage) {
+            summary_t summary = summarize(times[stage]);
+            stream << stage_names[stage] << "," << summary.mean << "," << summary.p50 << "," << summary.p99
+                << "," << summary.min << "," << summary.max << "\n";
+        }
+
+        // the checksum goes to stderr so the report stays plain csv
+        std::cerr << "checksum " << hash_text << "\n";
+        return;
+    }
+
+    stream << "{\n";
+    stream << "  \"level\": \"" << options.level << "\",\n";
+    if (options.level == "maze") {
+        stream << "  \"seed\": " << options.seed << ",\n";
+        stream << "  \"size\": " << options.size << ",\n";
+    }
+    stream << "  \"path\": \"" << (options.path.empty() ? "scripted" : options.path) << "\",\n";
+    stream << "  \"width\": " << options.width << ",\n";
+    stream << "  \"height\": " << options.height << ",\n";
+    stream << "  \"frames\": " << options.frames << ",\n";
+    stream << "  \"warmup\": " << options.warmup << ",\n";
+    stream << "  \"threaded\": " << (options.threaded ? "true" : "false") << ",\n";
+    stream << "  \"visibility_buffer\": " << (options.visibility_buffer ? "true" : "false") << ",\n";
+    stream << "  \"wireframe\": " << (options.wireframe ? "true" : "false") << ",\n";
+    stream << "  \"block_size\": " << options.block_size << ",\n";
+    stream << "  \"depth_format\": \"" << depth_format_name(options.depth_format) << "\",\n";
+    stream << "  \"checksum\": \"" << hash_text << "\",\n";
+    stream << "  \"stages_ms\": {\n";
+
+    for (unsigned int stage = 0; stage < num_stages; ++stage) {
+        summary_t summary = summarize(times[stage]);
+        stream << "    \"" << stage_names[stage] << "\": { \"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+            << ", \"p99\": " << summary.p99 << ", \"min\": " << summary.min << ", \"max\": " << summary.max << " }"
+            << (stage + 1 < num_stages ? ",\n" : "\n");
+    }
+
+    stream << "  },\n";
+    stream << "  \"pipeline_per_frame\": {\n";
+
+    const unsigned int num_counters = sizeof(pipeline_counters) / sizeof(pipeline_counters[0]);
+    for (unsigned int i = 0; i < num_counters; ++i) {
+        stream << "    \"" << pipeline_counters[i].name << "\": " << (double)(stats.*pipeline_counters[i].counter) / options.frames
+            << (i + 1 < num_counters ? ",\n" : "\n");
+    }
+
+    stream << "  }\n";
+    stream << "}\n";
+}
+
+void run(const options_t & options) {
+    std::unique_ptr<Level> level;
+
+    if (options.level == "maze") {
+        level = std::make_unique<Maze>(options.size, options.size, options.seed);
+    } else {
+        level = std::make_unique<Room>();
+    }
+
+    std::vector<camera_pose_t> path;
+    if (!options.path.empty()) {
+        path = load_path(options.path);
+    }
+
+    GraphicsContext context(options.width, options.height);
+    context.set_threaded(options.threaded);
+    context.set_visibility_buffer(options.visibility_buffer);
+    context.set_wireframe(options.wireframe);
+    context.set_block_size(options.block_size);
+    context.set_depth_format(options.depth_format);
+
+    mat_t<float> projection_mat = perspective(options.width, options.height, PI_f / 3.0f);
+
+    std::vector<double> times[num_stages];
+    for (std::vector<double> & stage_times : times) {
+        stage_times.reserve(options.frames);
+    }
+
+    pipeline_stats_t stats;
+
+    for (unsigned int frame = 0; frame < options.warmup + options.frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        double elapsed[num_stages];
+
+        auto lap = [&start](double & time) {
+            auto now = std::chrono::steady_clock::now();
+            time = std::chrono::duration<double, std::milli>(now - start).count();
+            start = now;
+        };
+
+        if (path.empty()) {
+            play_script(*level, frame);
+        }
+
+        level->update(time_step);
+
+        // a recorded pose overrides where the player put the camera
+        if (!path.empty()) {
+            const camera_pose_t & pose = path[frame % path.size()];
+            level->set_camera_eye(pose.eye);
+            level->set_camera_at(pose.at);
+        }
+
+        lap(elapsed[stage_update]);
+
+        context.clear();
+        lap(elapsed[stage_clear]);
+
+        level->render(context, projection_mat);
+        lap(elapsed[stage_render]);
+
+        context.flush();
+        lap(elapsed[stage_flush]);
+
+        context.finish();
+        lap(elapsed[stage_finish]);
+
+        if (frame < options.warmup) {
+            continue;
+        }
+
+        elapsed[stage_total] = 0.0;
+        for (unsigned int stage = 0; stage < stage_total; ++stage) {
+            elapsed[stage_total] += elapsed[stage];
+        }
+
+        for (unsigned int stage = 0; stage < num_stages; ++stage) {
+            times[stage].push_back(elapsed[stage]);
+        }
+
+        stats += context.get_stats();
+    }
+
+    const uint64_t hash = checksum(context);
+
+    if (options.out.empty()) {
+        report(std::cout, options, times, stats, hash);
+    } else {
+        std::ofstream file(options.out);
+
+        if (!file) {
+            throw std::runtime_error("failed to open report file: " + options.out);
+        }
+
+        report(file, options, times, stats, hash);
+    }
+}
+
+int main(int argc, char ** argv) {
+    try {
+        options_t options = parse_options(argc, argv);
+
+        // only surfaces and image loading are used, no video subsystem
+        if (SDL_Init(0) < 0) {
+            throw std::runtime_error("failed to initialize sdl2");
+        }
+
+        if (IMG_Init(IMG_INIT_PNG) < 0) {
+            throw std::runtime_error("failed to initialize image loading");
+        }
+
+        run(options);
+
+        IMG_Quit();
+        SDL_Quit();
+    } catch (const std::exception & e) {
+        std::cerr << "bench: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
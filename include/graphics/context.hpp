@@ -1,34 +1,156 @@
 #pragma once
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
 
 #include <vector>
-#include <chrono>
+#include <memory>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "graphics/triangle.hpp"
+#include "graphics/thread_pool.hpp"
 
 struct color_t {
     uint8_t r, g, b, a;
     color_t() : r(0), g(0), b(0), a(SDL_ALPHA_OPAQUE) { }
     color_t(uint8_t r, uint8_t g, uint8_t b, uint8_t a) : r(r), g(g), b(b), a(a) { }
     color_t(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b), a(SDL_ALPHA_OPAQUE) { }
+
+    // packed in the framebuffer's native ARGB8888 format
+    uint32_t to_argb() const { return (uint32_t(a) << 24) | (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b); }
+};
+
+// how the depth buffer stores a pixel's depth, w is the distance along the view
+// direction and z = 1 / w is what is interpolated across a triangle
+enum class depth_format_t {
+    float32,          // w as a float, nearer pixels have smaller values
+    reversed_float32, // z as a float, nearer pixels have larger values
+    unorm16           // z as a 16 bit normalized integer, half the memory traffic
+};
+
+// what the pipeline did with a frame, the geometry counters are filled in by the
+// models drawing into the context and the rest by the context itself
+// within one build they do not depend on threading or the depth format. pixels_tested
+// and blocks_hiz_culled change with the block size, and with deferred texturing
+// texture_samples only counts the pixels left visible. scalar and avx2 builds round
+// differently and may differ by a few pixels
+struct pipeline_stats_t {
+    uint64_t triangles_submitted = 0;  // triangles of everything drawn
+    uint64_t triangles_rejected = 0;   // entirely outside the view
+    uint64_t clipped_away = 0;         // crossed the near plane or the guard band and nothing was left
+    uint64_t clipped_to_one = 0;       // same, and one triangle was left
+    uint64_t clipped_to_two = 0;       // same, and the rest was split into two
+    uint64_t clipped_to_more = 0;      // same, and the rest was split into more than two
+    uint64_t triangles_backface = 0;   // back-face culled, after clipping
+    uint64_t triangles_degenerate = 0; // empty bounding box or no area after snapping
+    uint64_t triangles_rasterized = 0;
+    uint64_t blocks_hiz_culled = 0;    // blocks rejected against the depth tiles without a pixel being tested
+    uint64_t pixels_tested = 0;        // pixels of the blocks rasterized, covered or not
+    uint64_t depth_passed = 0;         // covered pixels that were written, including blocks that passed as a whole
+    uint64_t depth_failed = 0;         // covered pixels hidden by something nearer
+    uint64_t texture_samples = 0;
+
+    pipeline_stats_t& operator+=(const pipeline_stats_t& other) {
+        triangles_submitted += other.triangles_submitted;
+        triangles_rejected += other.triangles_rejected;
+        clipped_away += other.clipped_away;
+        clipped_to_one += other.clipped_to_one;
+        clipped_to_two += other.clipped_to_two;
+        clipped_to_more += other.clipped_to_more;
+        triangles_backface += other.triangles_backface;
+        triangles_degenerate += other.triangles_degenerate;
+        triangles_rasterized += other.triangles_rasterized;
+        blocks_hiz_culled += other.blocks_hiz_culled;
+        pixels_tested += other.pixels_tested;
+        depth_passed += other.depth_passed;
+        depth_failed += other.depth_failed;
+        texture_samples += other.texture_samples;
+        return *this;
+    }
 };
 
 class GraphicsContext {
     private:
-        SDL_Window * m_window;
-        SDL_Renderer * m_renderer;
-        SDL_Texture * m_texture;
-        TTF_Font * m_font;
+        static constexpr unsigned int tile_size = 64;
+        static constexpr unsigned int depth_tile_size = 8;
+        static constexpr float depth_epsilon = 1e-5f;
+        static constexpr int64_t subpixel_scale = 16; // 28.4 fixed point vertex positions
+        static constexpr std::size_t buffer_alignment = 4096; // frame buffers start on a page
+
+        // depth tiles never straddle two raster tiles, so threads never share them
+        static_assert(tile_size % depth_tile_size == 0, "raster tiles must be made of whole depth tiles");
 
+        // edge equation in fixed point, w(x, y) = a * x + b * y + c stepped in whole pixels,
+        // bias is -1 for edges that are not top-left so the test is always w + bias >= 0
+        struct edge_t {
+            int64_t a, b, c, bias;
+
+            int64_t at(int64_t dx, int64_t dy) const {
+                return a * dx + b * dy + c + bias;
+            }
+        };
+
+        // everything a block of pixels needs to rasterize a triangle, the attribute
+        // planes are relative to the same origin as the edges
+        struct triangle_setup_t {
+            edge_t e1, e2, e3;
+            int origin_x, origin_y;
+            float za, zb, zc;
+            float ua, ub, uc;
+            float va, vb, vc;
+            float z_min, z_max;
+            // texel derivatives times z^2, du/dx only varies with y and du/dy with x
+            float dudx_b, dudx_c, dvdx_b, dvdx_c;
+            float dudy_a, dudy_c, dvdy_a, dvdy_c;
+            int min_x, max_x, min_y, max_y;
+            unsigned int id; // index + 1 in the frame, stored in the visibility buffer
+            const Texture * texture;
+        };
+
+    private:
         unsigned int m_width;
         unsigned int m_height;
 
-        uint8_t * m_buffer = nullptr;
+        // the context's own color buffer, one ARGB8888 pixel per element
+        uint32_t * m_buffer = nullptr;
+
+        // where color is drawn, m_buffer unless set_color_buffer pointed it
+        // elsewhere, the pitch is in pixels
+        uint32_t * m_pixels = nullptr;
+        unsigned int m_pitch;
+
         float * m_depthBuffer = nullptr;
-        
-        std::chrono::steady_clock::time_point m_last_frame;
-        unsigned int m_frames, m_frameTimer, m_fpsAvg;
+        uint32_t * m_visibilityBuffer = nullptr;
 
         bool m_wireframe;
+        bool m_threaded;
+        bool m_deferred;
+        unsigned int m_block_size;
+        depth_format_t m_depth_format;
+
+        // sort-middle rasterization, triangles are binned into screen tiles
+        // and every tile is rasterized by exactly one thread on flush
+        unsigned int m_tiles_x, m_tiles_y;
+        std::vector<triangle_setup_t> m_triangles;
+        std::vector<std::vector<unsigned int>> m_tile_bins;
+        std::unique_ptr<ThreadPool> m_pool;
+
+        // hierarchical depth, nearest and farthest depth stored in every depth tile
+        unsigned int m_depth_tiles_x, m_depth_tiles_y;
+        std::vector<float> m_depth_tile_min;
+        std::vector<float> m_depth_tile_max;
+
+        // clears are lazy, a depth tile nothing was drawn to since the last clear (its
+        // nearest depth is still the far value) is cleared when it is first drawn to and
+        // the color of pixels nothing was drawn to is cleared once before it is shown
+        bool m_color_cleared = false;
+
+        // counters of the frame since the last clear, tiles count into their own
+        // entry while they are rendered and are added up on flush
+        pipeline_stats_t m_stats;
+        std::vector<pipeline_stats_t> m_tile_stats;
+        unsigned int m_frame_number = 0;
 
     public:
         unsigned int get_width();
@@ -37,23 +159,89 @@ class GraphicsContext {
         void set_wireframe(bool value);
         bool is_wireframe();
 
+        void set_threaded(bool value);
+        bool is_threaded();
+
+        // deferred texturing, triangles only write depth and their id and
+        // every visible pixel is textured once when the frame is flushed
+        void set_visibility_buffer(bool value);
+        bool is_visibility_buffer();
+
+        // depth already drawn is dropped when the format changes
+        void set_depth_format(depth_format_t value);
+        depth_format_t get_depth_format();
+
+        // size of the blocks classified against the triangle edges before per pixel tests, 0 disables it
+        void set_block_size(unsigned int value);
+        unsigned int get_block_size();
+
     public:
-        GraphicsContext(SDL_Window * window, unsigned int resX, unsigned int resY);
+        // a software render target, it needs no window and shows nothing by
+        // itself, see Presenter for putting frames on screen
+        GraphicsContext(unsigned int resX, unsigned int resY);
         ~GraphicsContext();
 
         GraphicsContext(const GraphicsContext&) = delete;
         GraphicsContext& operator=(const GraphicsContext&) = delete;
 
         void clear();
-        void present();
+        void flush();
+
+        // flushes and completes the frame, every pixel of the color buffer is defined afterwards
+        void finish();
+
+        // color is drawn to pixels from now on, rows pitch pixels apart, instead of the
+        // context's own buffer. nullptr goes back to the own buffer
+        void set_color_buffer(uint32_t * pixels, unsigned int pitch);
+        const uint32_t * get_color_buffer();
+        unsigned int get_pitch();
+
+        // counters of the current frame, complete once it is flushed. models add
+        // their geometry counters, the frame number tells them when a frame starts
+        const pipeline_stats_t& get_stats();
+        void add_stats(const pipeline_stats_t& stats);
+        unsigned int get_frame_number();
 
     public: // drawing functions
-        bool set_depth(unsigned int x, unsigned int y, float depth);
         void set_pixel(unsigned int x, unsigned int y, const color_t& color);
         void set_pixel_s(unsigned int x, unsigned int y, const color_t& color);
         void draw_line(int x0, int y0, int x1, int y1, const color_t& color);
-        void render_text(int x, int y, const char * text);
+        void draw_triangle(const raster_triangle_t& triangle);
 
     private:
-        void setup_texture();
-};
\ No newline at end of file
+        void setup_buffers();
+        void clear_untouched();
+        inline bool is_depth_cleared(int index);
+        template<depth_format_t format> inline void clear_depth_tile(unsigned int tile_x, unsigned int tile_y);
+        void render_tile(std::size_t tile);
+        void resolve(const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats);
+
+        bool setup_triangle(const raster_triangle_t& triangle, triangle_setup_t& setup);
+        template<bool deferred> void fill_triangle(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats);
+        template<depth_format_t format, bool deferred> void fill_blocks(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats);
+        template<depth_format_t format, bool deferred> inline void fill_coarse_block(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats);
+        template<depth_format_t format, bool test_edges, bool test_depth, bool deferred> inline void fill_block(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats);
+        template<depth_format_t format> inline void update_depth_tiles(const int min_x, const int max_x, const int min_y, const int max_y, float depth_near, float depth_far, bool overwritten);
+
+        // per pixel depth test and write, z is the interpolated 1 / w and depth = 1 / z
+        template<depth_format_t format> inline bool test_depth_pixel(int index, float z, float depth);
+        template<depth_format_t format> inline void write_depth_pixel(int index, float z, float depth);
+        static inline uint16_t depth_unorm16(float z);
+
+        // mip level of the aligned span of 8 pixels holding (x, y)
+        inline int select_level(const triangle_setup_t& setup, int x, int y);
+        inline uint32_t sample_texture(const triangle_setup_t& setup, float u, float v, int level);
+        inline edge_t setup_edge(int64_t ax, int64_t ay, int64_t bx, int64_t by, int origin_x, int origin_y);
+
+        template <typename T> static T * allocate_buffer(std::size_t size);
+        static void free_buffer(void * buffer);
+
+#if defined(__AVX2__)
+        inline void shade_pixels(const triangle_setup_t& setup, uint32_t * pixels, int x, int y, __m256 u, __m256 v, __m256i mask);
+
+        // same for eight pixels, count is the number of them left in the span
+        static inline __m256i depth_unorm16(__m256 z);
+        template<depth_format_t format> inline __m256 test_depth_pixels(int index, int count, __m256 z, __m256 depth, __m256 mask);
+        template<depth_format_t format> inline void write_depth_pixels(int index, int count, __m256 z, __m256 depth, __m256i mask);
+#endif
+};
@@ -1,50 +1,95 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <memory>
 #include <SDL2/SDL.h>
 
 #include "math/matrix.hpp"
 #include "math/vector.hpp"
+#include "math/points.hpp"
+#include "math/frustum.hpp"
 
 #include "graphics/context.hpp"
 #include "graphics/texture.hpp"
+#include "graphics/triangle.hpp"
 
 class Model {
     private:
-        struct vertex_t {
-            vec_t<float> pos;
-            float u, v;
+        std::shared_ptr<const Texture> m_texture;
+        points_t m_positions; // w is not stored, it is always 1
+        aligned_vector<float> m_tex_u, m_tex_v;
+        std::vector<unsigned int> m_indices;
 
-            vertex_t() : pos(0.0f), u(0.0f), v(0.0f) { }
-            vertex_t(const vec_t<float>& pos, float u, float v) : pos(pos), u(u), v(v) { }
-            vertex_t(float x, float y, float z, float u, float v) : pos(x, y, z), u(u), v(v) { }
+        // model space bounds
+        aabb_t m_bounding_box;
+        sphere_t m_bounding_sphere;
+
+        // a contiguous run of triangles that can be drawn on its own
+        struct group_t {
+            unsigned int first_index, num_indices;
+            unsigned int first_vertex, num_vertices;
+            aabb_t bounds;
         };
 
-        struct triangle_t {
-            vertex_t v1, v2, v3;
-            triangle_t() { }
-            triangle_t(const vertex_t& v1, const vertex_t& v2, const vertex_t& v3) : v1(v1), v2(v2), v3(v3) { }
+        std::vector<group_t> m_groups;
+
+        // per draw post-transform cache, one entry per unique vertex
+        points_t m_clip_positions;
+        points_t m_screen_positions;
+        std::vector<unsigned int> m_outcodes;
+
+        // geometry counters of the draw in progress and of all draws of the
+        // context's current frame, the context gets a copy of every draw's
+        pipeline_stats_t m_draw_stats;
+        pipeline_stats_t m_stats;
+        unsigned int m_stats_frame = 0;
+
+        // clip space outcodes, only the near plane and the guard band are clipped
+        // against, the viewport planes are used for trivial rejection only
+        enum : unsigned int {
+            clip_near = 1 << 0,
+            clip_guard_left = 1 << 1,
+            clip_guard_right = 1 << 2,
+            clip_guard_top = 1 << 3,
+            clip_guard_bottom = 1 << 4,
+            clip_left = 1 << 5,
+            clip_right = 1 << 6,
+            clip_top = 1 << 7,
+            clip_bottom = 1 << 8,
+            clip_mask = clip_near | clip_guard_left | clip_guard_right | clip_guard_top | clip_guard_bottom
         };
 
-        Texture m_texture;
-        std::vector<triangle_t> m_triangles;
+        // distance of the guard band from the viewport in pixels, small enough to
+        // keep the rasterizer's 28.4 fixed point setup exact
+        static constexpr float guard_band = 8192.0f;
 
     public:
-        Model(std::vector<float> positions, std::vector<unsigned int> indices, std::vector<float> tex_coords, const Texture & texture);
+        // groups holds the number of triangles of each group, in index order
+        Model(std::vector<float> positions, std::vector<unsigned int> indices, std::vector<float> tex_coords, std::shared_ptr<const Texture> texture, std::vector<unsigned int> groups = std::vector<unsigned int>());
         void render(GraphicsContext& context, const mat_t<float>& projection, const mat_t<float>& world_view);
+        void render(GraphicsContext& context, const mat_t<float>& projection, const mat_t<float>& world_view, const std::vector<unsigned int>& groups);
+
+        // what the pipeline did with the model in the current frame, up to rasterization
+        const pipeline_stats_t& get_stats() const;
+
+        const aabb_t& get_bounding_box() const;
+        const sphere_t& get_bounding_sphere() const;
+
+        unsigned int get_num_groups() const;
+        const aabb_t& get_group_bounds(unsigned int group) const;
 
     private:
-        void fill_scanlines(GraphicsContext& context, const triangle_t& triangle, const float area, const int min_x, const int max_x, const int min_y, const int max_y, const int step);
-        void fill_triangle(GraphicsContext& context, triangle_t& triangle, const mat_t<float>& projection, bool wireframe = false);
+        void transform_vertices(const mat_t<float>& clip, unsigned int first_vertex, unsigned int num_vertices, float width, float height);
+        void draw_triangles(GraphicsContext& context, unsigned int first_index, unsigned int num_indices);
+        void begin_draw(GraphicsContext& context);
+        void end_draw(GraphicsContext& context);
+        void fill_triangle(GraphicsContext& context, const triangle_t& triangle, bool wireframe = false);
 
         // inline functions
-        inline float signed_distance(const vec_t<float>& normal, float d, const vec_t<float>& point);
-        inline float intersect(const vec_t<float>& v1, const vec_t<float>& v2, const vec_t<float>& normal, float d);
+        inline vertex_t clip_vertex(unsigned int index);
+        inline vertex_t screen_vertex(unsigned int index);
+        inline float plane_distance(unsigned int plane, const vec_t<float>& p, float width, float height);
+        inline unsigned int clip_polygon(unsigned int plane, const vertex_t * in, unsigned int count, vertex_t * out, float width, float height);
 
-        inline void clip_triangle(const vec_t<float>& normal, float d, vertex_t& v1, vertex_t& v2, vertex_t& v3);
-        inline void clip_triangle(const vec_t<float>& normal, float d, vertex_t& v1, vertex_t& v2, vertex_t& v3, triangle_t& out_t1, triangle_t& out_t2);
-        
-        inline void sample_texture(float u, float v, color_t & out_color);
         inline float edge_function(const vec_t<float>& a, const vec_t<float>& b, const vec_t<float>& c);
-        inline float edge_function(const vec_t<float>& a, const vec_t<float>& b, int cx, int cy);
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "graphics/context.hpp"
+#include "math/points.hpp"
+
+// puts the frames of a GraphicsContext into a window. the context draws into one frame
+// on a drawing thread while the previous one is uploaded and shown by the thread that
+// created the presenter, which is the only one making sdl render calls
+class Presenter {
+    private:
+        // text drawn over a frame when it is presented, the characters of all texts
+        // of a frame are kept in one string so queuing text does not allocate
+        struct text_t {
+            int x, y;
+            unsigned int first, length;
+        };
+
+        // a frame handed back and forth between the drawing thread and show(),
+        // buffer holds one ARGB8888 pixel per element and is copied into the texture as
+        // is, in zero-copy mode the frame is drawn into the locked texture instead
+        struct frame_t {
+            std::vector<uint32_t, aligned_allocator<uint32_t, 4096>> buffer;
+            SDL_Texture * texture = nullptr;
+            uint32_t * pixels = nullptr;
+            unsigned int pitch = 0;
+            bool locked = false;
+            std::vector<text_t> texts;
+            std::string chars;
+        };
+
+        // with two frames one is drawn while the other is presented, a third
+        // would let the rasterizer run another frame ahead
+        static constexpr unsigned int num_frames = 2;
+
+    private:
+        SDL_Window * m_window;
+        SDL_Renderer * m_renderer = nullptr; // only used on the thread that created the presenter
+        TTF_Font * m_font;
+
+        GraphicsContext& m_context;
+        unsigned int m_width;
+        unsigned int m_height;
+
+        // the printable ascii glyphs of m_font side by side in one texture, built once
+        // so text is drawn with one copy per character
+        static constexpr char first_glyph = ' ', last_glyph = '~';
+        SDL_Texture * m_glyph_atlas = nullptr;
+        SDL_Rect m_glyph_rects[last_glyph - first_glyph + 1];
+        int m_glyph_height;
+
+        frame_t m_frame_buffers[num_frames];
+        unsigned int m_current_frame;
+        std::atomic<bool> m_zero_copy;
+
+        // frames waiting for the drawing thread and for show()
+        std::mutex m_present_mutex;
+        std::condition_variable m_present_cv;
+        std::deque<unsigned int> m_free_frames;
+        std::deque<unsigned int> m_queued_frames;
+        bool m_present_stop = false;
+
+        std::chrono::steady_clock::time_point m_last_frame;
+        unsigned int m_frames, m_frameTimer, m_fpsAvg;
+
+    public:
+        // draw straight into the streaming texture instead of copying the frame into
+        // it on present, takes effect once the frames in flight have been presented
+        void set_zero_copy(bool value);
+        bool is_zero_copy();
+
+    public:
+        // created on the thread that owns the window, the context draws into the
+        // presenter's frames until it is destroyed
+        Presenter(SDL_Window * window, GraphicsContext& context);
+        ~Presenter();
+
+        Presenter(const Presenter&) = delete;
+        Presenter& operator=(const Presenter&) = delete;
+
+        // called on the drawing thread, finishes the context's frame, hands it
+        // to show() and returns as soon as another frame is free to draw to
+        void present();
+
+        // drawn over the frame when it is presented, \n starts a new line
+        void render_text(int x, int y, const char * text);
+
+        // called on the thread that created the presenter, waits for the next frame and
+        // puts it on the window, returns false without one once the presenter is closed
+        bool show();
+
+        // neither show() nor present() wait for frames any more, so the drawing thread
+        // can be joined before the presenter is destroyed
+        void close();
+
+    private:
+        void acquire_frame();
+        void prepare_frame(frame_t& frame);
+        void destroy_textures();
+        void build_glyph_atlas();
+        void draw_text(const frame_t& frame, const text_t& text);
+};
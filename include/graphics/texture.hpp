@@ -4,12 +4,34 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 class Texture {
+	public:
+		// the mip chain stops at 4 texels on the short side, texel offsets are 32 bit so
+		// no texture has sides longer than 2^31 and never more levels than this
+		static constexpr unsigned int max_levels = 32;
+
+		// layout of every mip level inside the texel buffer, only the first get_num_levels() entries are used
+		struct levels_t {
+			int32_t offset[max_levels];
+			int32_t width[max_levels];
+			int32_t height[max_levels];
+			int32_t tiles_shift[max_levels];
+		};
+
 	private:
 		std::vector<uint8_t> m_buffer;
 		unsigned int m_width, m_height;
 
+		// ARGB8888 copy of the image used for sampling, resized to power of two dimensions
+		// (at least 4x4) so coordinates wrap with a mask, and stored in 4x4 tiles so
+		// nearby texels share a cache line whichever way the texture is walked. the
+		// box filtered mip levels follow the base level in the same layout
+		std::vector<uint32_t> m_texels;
+		levels_t m_levels;
+		unsigned int m_num_levels;
+
 	public:
 		unsigned int get_width() const;
 		unsigned int get_height() const;
@@ -17,6 +39,24 @@ class Texture {
 		const std::vector<uint8_t>& get_buffer() const;
 		std::vector<uint8_t>& get_buffer();
 
+		// texel (x, y) of level l lives at offset[l] + get_texel_index(x & (width[l] - 1), y & (height[l] - 1), tiles_shift[l])
+		const uint32_t * get_texels() const;
+		const levels_t & get_levels() const;
+		unsigned int get_num_levels() const;
+
+		static inline unsigned int get_texel_index(unsigned int x, unsigned int y, unsigned int tiles_shift) {
+			return ((((y >> 2) << tiles_shift) | (x >> 2)) << 4) | ((y & 3) << 2) | (x & 3);
+		}
+
 		Texture();
 		Texture(const std::string & filename);
+
+		// returns the texture loaded from filename, shared with every other caller
+		// asking for the same path. an image is decoded once and freed when the
+		// last handle to it goes away
+		static std::shared_ptr<const Texture> load(const std::string & filename);
+
+	private:
+		void build_texels();
+		void build_mip_level();
 };
\ No newline at end of file
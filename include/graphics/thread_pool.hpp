@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class ThreadPool {
+    private:
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_start_cv;
+        std::condition_variable m_done_cv;
+
+        const std::function<void(std::size_t)> * m_job = nullptr;
+        std::size_t m_job_count = 0;
+        std::atomic<std::size_t> m_next_job;
+
+        unsigned int m_generation = 0;
+        unsigned int m_active = 0;
+        bool m_stop = false;
+
+    public:
+        ThreadPool(unsigned int num_threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned int get_size() const;
+
+        // runs job(0) ... job(count - 1) on the workers and the calling thread, returns when all are done
+        void parallel_for(std::size_t count, const std::function<void(std::size_t)>& job);
+
+    private:
+        void worker();
+        void run_jobs();
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include "math/vector.hpp"
+
+class Texture;
+
+struct vertex_t {
+    vec_t<float> pos;
+    float u, v;
+
+    vertex_t() : pos(0.0f), u(0.0f), v(0.0f) { }
+    vertex_t(const vec_t<float>& pos, float u, float v) : pos(pos), u(u), v(v) { }
+    vertex_t(float x, float y, float z, float u, float v) : pos(x, y, z), u(u), v(v) { }
+};
+
+struct triangle_t {
+    vertex_t v1, v2, v3;
+    triangle_t() { }
+    triangle_t(const vertex_t& v1, const vertex_t& v2, const vertex_t& v3) : v1(v1), v2(v2), v3(v3) { }
+};
+
+// triangle after projection and perspective divide, ready to be rasterized
+struct raster_triangle_t {
+    triangle_t triangle;
+    float area;
+    int min_x, max_x, min_y, max_y;
+    const Texture * texture;
+
+    raster_triangle_t() : area(0.0f), min_x(0), max_x(0), min_y(0), max_y(0), texture(nullptr) { }
+    raster_triangle_t(const triangle_t& triangle, float area, int min_x, int max_x, int min_y, int max_y, const Texture * texture) :
+        triangle(triangle), area(area), min_x(min_x), max_x(max_x), min_y(min_y), max_y(max_y), texture(texture) { }
+};
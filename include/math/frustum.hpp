@@ -0,0 +1,37 @@
+#pragma once
+
+#include "math/matrix.hpp"
+#include "math/vector.hpp"
+
+struct sphere_t {
+    vec_t<float> center;
+    float radius;
+
+    sphere_t() : center(0.0f), radius(0.0f) { }
+    sphere_t(const vec_t<float>& center, float radius) : center(center), radius(radius) { }
+};
+
+struct aabb_t {
+    vec_t<float> min;
+    vec_t<float> max;
+
+    aabb_t() : min(0.0f), max(0.0f) { }
+    aabb_t(const vec_t<float>& min, const vec_t<float>& max) : min(min), max(max) { }
+};
+
+// the near plane and the four viewport planes of a pixel space projection
+// (see perspective()), extracted from projection * view so volumes can be
+// tested in whatever space the view matrix maps from
+class frustum_t {
+    private:
+        static constexpr int num_planes = 5;
+
+        // a * x + b * y + c * z + d >= 0 inside, (a, b, c) normalized
+        float m_planes[num_planes][4];
+
+    public:
+        frustum_t(const mat_t<float>& projection_view, float width, float height);
+
+        bool intersects(const sphere_t& sphere) const;
+        bool intersects(const aabb_t& box) const;
+};
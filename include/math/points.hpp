@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "math/matrix.hpp"
+
+// minimal allocator handing out storage aligned for simd loads and stores
+template <typename T, std::size_t Align> struct aligned_allocator {
+    typedef T value_type;
+
+    template <typename U> struct rebind {
+        typedef aligned_allocator<U, Align> other;
+    };
+
+    aligned_allocator() { }
+    template <typename U> aligned_allocator(const aligned_allocator<U, Align>&) { }
+
+    T * allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+
+    void deallocate(T * p, std::size_t) {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+
+    template <typename U> bool operator==(const aligned_allocator<U, Align>&) const { return true; }
+    template <typename U> bool operator!=(const aligned_allocator<U, Align>&) const { return false; }
+};
+
+template <typename T> using aligned_vector = std::vector<T, aligned_allocator<T, 32>>;
+
+// points stored as a structure of arrays so a batch can be processed
+// 8 at a time, each component array is 32 byte aligned
+struct points_t {
+    aligned_vector<float> x, y, z, w;
+
+    void resize(std::size_t n) {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+        w.resize(n);
+    }
+
+    std::size_t size() const {
+        return x.size();
+    }
+};
+
+// out = t * in for n points starting at first, the w of the input is taken to be 1
+// and in.w is never read, so it may be left empty
+void transform_points(const mat_t<float>& t, const points_t& in, points_t& out, std::size_t first, std::size_t n);
+
+inline void transform_points(const mat_t<float>& t, const points_t& in, points_t& out, std::size_t n) {
+    transform_points(t, in, out, 0, n);
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "math/vector.hpp"
 #include "math/matrix.hpp"
+#include "math/frustum.hpp"
 
 #include "graphics/context.hpp"
 
@@ -16,6 +17,13 @@ class Entity {
 		mat_t<float> m_world;
 		bool m_recalculate_matrix = true;
 
+		// model space bounding sphere, entities without one are never culled
+		sphere_t m_bound;
+		bool m_has_bound = false;
+
+	protected:
+		void set_bound(const sphere_t & bound);
+
 	public:
 		Entity();
 
@@ -24,6 +32,9 @@ class Entity {
 		const vec_t<float> & get_scale();
 		const mat_t<float> & get_world();
 
+		bool has_bound() const;
+		sphere_t get_world_bound();
+
 		void set_position(const vec_t<float> & position);
 		void set_rotation(const vec_t<float> & rotation);
 		void set_scale(const vec_t<float> & scale);
@@ -13,6 +13,9 @@ class Maze : public Level {
 		static constexpr float tile_width = 6.0f;
 		static constexpr float tile_height = 6.0f;
 
+		// tiles per side of a chunk, the unit of frustum and distance culling
+		static constexpr int chunk_size = 8;
+
 		enum map_square_t {
 			wall = 0,
 			empty = 1
@@ -30,11 +33,51 @@ class Maze : public Level {
 		std::unique_ptr<Model> m_model;
 		std::unique_ptr<Model> m_floor_model;
 
+		// portal visibility, every reached tile keeps the screen rectangle it is seen through
+		struct screen_rect_t {
+			float min_x, min_y, max_x, max_y;
+			screen_rect_t() : min_x(0.0f), min_y(0.0f), max_x(0.0f), max_y(0.0f) { }
+			screen_rect_t(float min_x, float min_y, float max_x, float max_y) : min_x(min_x), min_y(min_y), max_x(max_x), max_y(max_y) { }
+		};
+
+		std::vector<screen_rect_t> m_tile_rects;
+		std::vector<bool> m_tile_queued;
+		std::vector<unsigned int> m_visible_tiles;
+		std::vector<unsigned int> m_tile_stack; // kept between frames so traversal does not allocate
+
+		enum chunk_flag_t : unsigned char {
+			chunk_in_range = 1 << 0,
+			chunk_in_view = 1 << 1,
+			chunk_reached = 1 << 2
+		};
+
+		int m_chunks_x;
+		int m_chunks_y;
+		std::vector<aabb_t> m_chunk_bounds;
+		std::vector<unsigned char> m_chunk_flags;
+		std::vector<unsigned int> m_visible_chunks;
+
+		// merged wall runs, the runs of chunk c are m_chunk_runs[c] to m_chunk_runs[c + 1],
+		// the runs touching tile t are listed from m_tile_runs_first[t] to m_tile_runs_first[t + 1]
+		std::vector<unsigned int> m_chunk_runs;
+		std::vector<unsigned int> m_tile_runs_first;
+		std::vector<unsigned int> m_tile_runs;
+		std::vector<unsigned int> m_run_stamps;
+		unsigned int m_frame = 0;
+
+		// groups handed to the wall and floor models
+		std::vector<unsigned int> m_wall_groups;
+		std::vector<unsigned int> m_floor_groups;
+
+		// chunks further away than this are skipped, 0 disables the limit
+		float m_draw_distance = 0.0f;
+
 		Player & m_player;
 		Cube & m_start_cube;
 
 	public:
 		Maze(int width, int height);
+		Maze(int width, int height, unsigned int seed);
 		Maze(int width, int height, std::vector<unsigned int> map);
 
 		void event(const SDL_Event& event) override;
@@ -46,14 +89,22 @@ class Maze : public Level {
 
 		vec_t<float> get_tile_pos(int x, int y);
 
+		void set_draw_distance(float distance);
+		float get_draw_distance() const;
+
 	private:
 		inline bool valid_neighbor(const map_square_pos_t& pos);
 		inline unsigned int get_index(const map_square_pos_t& pos);
+		inline unsigned int get_chunk(int x, int y);
 
 		void initialize_world();
-		void generate_maze();
+		void generate_maze(unsigned int seed);
 		void generate_mesh();
 
+		void find_visible_chunks(const frustum_t & frustum);
+		bool find_visible_tiles(const mat_t<float> & projection_view, float width, float height);
+		inline bool project_portal(const mat_t<float> & projection_view, float x0, float z0, float x1, float z1, const screen_rect_t & parent, screen_rect_t & out);
+
 	friend std::ostream & operator<<(std::ostream & stream, const Maze & maze);
 };
 
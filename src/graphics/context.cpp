@@ -3,7 +3,15 @@
 #include <iostream>
 #include <string>
 
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <bitset>
+
 #include "graphics/context.hpp"
+#include "graphics/texture.hpp"
 
 unsigned int GraphicsContext::get_width() {
     return m_width;
@@ -21,121 +29,292 @@ void GraphicsContext::set_wireframe(bool value) {
     m_wireframe = value;
 }
 
-GraphicsContext::GraphicsContext(SDL_Window * window, unsigned int resX, unsigned int resY) {
-    m_window = window;
+bool GraphicsContext::is_threaded() {
+    return m_threaded;
+}
 
+void GraphicsContext::set_threaded(bool value) {
+    flush();
+    m_threaded = value;
+}
+
+bool GraphicsContext::is_visibility_buffer() {
+    return m_deferred;
+}
+
+void GraphicsContext::set_visibility_buffer(bool value) {
+    flush();
+    m_deferred = value;
+}
+
+unsigned int GraphicsContext::get_block_size() {
+    return m_block_size;
+}
+
+void GraphicsContext::set_block_size(unsigned int value) {
+    flush();
+    m_block_size = value;
+}
+
+depth_format_t GraphicsContext::get_depth_format() {
+    return m_depth_format;
+}
+
+void GraphicsContext::set_depth_format(depth_format_t value) {
+    flush();
+
+    // the color drawn so far is kept, every depth tile starts over untouched
+    clear_untouched();
+    std::fill(m_depth_tile_min.begin(), m_depth_tile_min.end(), std::numeric_limits<float>::max());
+    std::fill(m_depth_tile_max.begin(), m_depth_tile_max.end(), std::numeric_limits<float>::max());
+
+    m_depth_format = value;
+}
+
+GraphicsContext::GraphicsContext(unsigned int resX, unsigned int resY) {
     m_width = resX;
     m_height = resY;
 
-    m_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    m_texture = nullptr;
-
-    setup_texture();
+    setup_buffers();
 
-    m_last_frame = std::chrono::steady_clock::now();
-    m_frameTimer = 0;
-    m_frames = 0;
-    m_fpsAvg = 0;
     m_wireframe = false;
+    m_threaded = true;
+    m_block_size = 8;
+    m_deferred = false;
+    m_depth_format = depth_format_t::float32;
+
+    // the calling thread also takes tiles, so one worker less than cores
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    m_pool = std::make_unique<ThreadPool>(num_threads - 1);
+}
+
+GraphicsContext::~GraphicsContext() {
+    free_buffer(m_buffer);
+    free_buffer(m_depthBuffer);
+    free_buffer(m_visibilityBuffer);
+}
+
+void GraphicsContext::clear() {
+    m_stats = pipeline_stats_t();
+    m_frame_number++;
+
+    // the color and depth buffers are cleared lazily, see clear_untouched and
+    // clear_depth_tile
+    m_color_cleared = false;
+    std::fill(m_depth_tile_min.begin(), m_depth_tile_min.end(), std::numeric_limits<float>::max());
+    std::fill(m_depth_tile_max.begin(), m_depth_tile_max.end(), std::numeric_limits<float>::max());
 
-    m_font = TTF_OpenFont("assets/font.ttf", 32);
-    if (!m_font) {
-        throw std::runtime_error("failed to initialize font");
+    // the resolve pass leaves the visibility buffer empty, it only
+    // needs clearing when triangles are dropped without a flush
+    if (m_deferred && !m_triangles.empty()) {
+        std::fill(m_visibilityBuffer, m_visibilityBuffer + m_width * m_height, 0);
     }
 
-    if (!m_renderer) {
-        throw std::runtime_error("failed to initialize renderer: " + std::string(SDL_GetError()));
+    m_triangles.clear();
+    for (std::vector<unsigned int>& bin : m_tile_bins) {
+        bin.clear();
     }
 }
 
-GraphicsContext::~GraphicsContext() {
-    if (m_font) {
-        TTF_CloseFont(m_font);
+void GraphicsContext::flush() {
+    if (m_triangles.empty()) {
+        return;
     }
 
-    if (m_renderer) {
-        SDL_DestroyRenderer(m_renderer);
-    }
+    if (m_threaded) {
+        m_pool->parallel_for(m_tile_bins.size(), [this](std::size_t tile) {
+            render_tile(tile);
+        });
 
-    if (m_buffer) {
-        delete [] m_buffer;
+        for (pipeline_stats_t& stats : m_tile_stats) {
+            m_stats += stats;
+            stats = pipeline_stats_t();
+        }
+    } else {
+        resolve(0, m_width, 0, m_height, m_stats);
     }
 
-    if (m_depthBuffer) {
-        delete [] m_depthBuffer;
+    m_triangles.clear();
+    for (std::vector<unsigned int>& bin : m_tile_bins) {
+        bin.clear();
     }
 }
 
-void GraphicsContext::clear() {
-    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(m_renderer);
+void GraphicsContext::finish() {
+    flush();
+    clear_untouched();
+}
+
+void GraphicsContext::set_color_buffer(uint32_t * pixels, unsigned int pitch) {
+    flush();
+
+    // whatever the new buffer holds is undefined until the next clear is done with
+    m_pixels = pixels ? pixels : m_buffer;
+    m_pitch = pixels ? pitch : m_width;
+    m_color_cleared = false;
+}
 
-    std::fill(m_buffer, m_buffer + m_width * m_height * 4, 0);
-    std::fill(m_depthBuffer, m_depthBuffer + m_width * m_height, std::numeric_limits<float>::max());
+const uint32_t * GraphicsContext::get_color_buffer() {
+    return m_pixels;
 }
 
-void GraphicsContext::present() {
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_last_frame).count();
+unsigned int GraphicsContext::get_pitch() {
+    return m_pitch;
+}
 
-    m_last_frame = now;
-    m_frameTimer += elapsed;
+const pipeline_stats_t& GraphicsContext::get_stats() {
+    return m_stats;
+}
 
-    if (m_frameTimer > 1000) {
-        m_fpsAvg = m_frames;
-        m_frames = 0;
-        m_frameTimer = m_frameTimer - 1000;
-    }
+void GraphicsContext::add_stats(const pipeline_stats_t& stats) {
+    m_stats += stats;
+}
+
+unsigned int GraphicsContext::get_frame_number() {
+    return m_frame_number;
+}
+
+void GraphicsContext::setup_buffers() {
+    free_buffer(m_buffer);
+    free_buffer(m_depthBuffer);
+    free_buffer(m_visibilityBuffer);
+
+    // color and depth are left uninitialized, every depth tile starts out untouched
+    m_buffer = allocate_buffer<uint32_t>(m_width * m_height);
+    m_pixels = m_buffer;
+    m_pitch = m_width;
+    m_depthBuffer = allocate_buffer<float>(m_width * m_height);
+    m_visibilityBuffer = allocate_buffer<uint32_t>(m_width * m_height);
+    std::fill(m_visibilityBuffer, m_visibilityBuffer + m_width * m_height, 0);
+    m_color_cleared = false;
 
-    // render frame
-    SDL_UpdateTexture(m_texture, nullptr, m_buffer, m_width * 4);
-    SDL_RenderCopy(m_renderer, m_texture, nullptr, nullptr);
+    m_tiles_x = (m_width + tile_size - 1) / tile_size;
+    m_tiles_y = (m_height + tile_size - 1) / tile_size;
 
-    render_text(30, 30, std::string("fps: " + std::to_string(m_fpsAvg)).c_str());
-    SDL_RenderPresent(m_renderer);
+    m_triangles.clear();
+    m_tile_bins.clear();
+    m_tile_bins.resize(m_tiles_x * m_tiles_y);
+    m_tile_stats.assign(m_tiles_x * m_tiles_y, pipeline_stats_t());
 
-    m_frames = m_frames + 1;
+    m_depth_tiles_x = (m_width + depth_tile_size - 1) / depth_tile_size;
+    m_depth_tiles_y = (m_height + depth_tile_size - 1) / depth_tile_size;
+
+    m_depth_tile_min.assign(m_depth_tiles_x * m_depth_tiles_y, std::numeric_limits<float>::max());
+    m_depth_tile_max.assign(m_depth_tiles_x * m_depth_tiles_y, std::numeric_limits<float>::max());
+}
+
+template <typename T> T * GraphicsContext::allocate_buffer(std::size_t size) {
+    return static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(buffer_alignment)));
 }
 
-void GraphicsContext::setup_texture() {
-    if (m_texture) {
-        SDL_DestroyTexture(m_texture);
+void GraphicsContext::free_buffer(void * buffer) {
+    if (buffer) {
+        ::operator delete(buffer, std::align_val_t(buffer_alignment));
     }
+}
 
-    m_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, 
-        SDL_TEXTUREACCESS_STREAMING, m_width, m_height);
+inline bool GraphicsContext::is_depth_cleared(int index) {
+    switch (m_depth_format) {
+        case depth_format_t::reversed_float32:
+            return m_depthBuffer[index] == 0.0f;
+        case depth_format_t::unorm16:
+            return reinterpret_cast<const uint16_t*>(m_depthBuffer)[index] == 0;
+        default:
+            return m_depthBuffer[index] == std::numeric_limits<float>::max();
+    }
+}
 
-    if (m_depthBuffer) {
-        delete [] m_depthBuffer;
+void GraphicsContext::clear_untouched() {
+    if (m_color_cleared) {
+        return;
     }
 
-    if (m_buffer) {
-        delete [] m_buffer;
+    const float far = std::numeric_limits<float>::max();
+
+    for (unsigned int ty = 0; ty < m_depth_tiles_y; ++ty) {
+        for (unsigned int tx = 0; tx < m_depth_tiles_x; ++tx) {
+            const unsigned int tile = ty * m_depth_tiles_x + tx;
+
+            // a finite far bound means every pixel of the tile was drawn
+            if (m_depth_tile_max[tile] != far) {
+                continue;
+            }
+
+            const int x0 = tx * depth_tile_size, x1 = std::min(x0 + (int)depth_tile_size, (int)m_width);
+            const int y0 = ty * depth_tile_size, y1 = std::min(y0 + (int)depth_tile_size, (int)m_height);
+            const bool untouched = m_depth_tile_min[tile] == far;
+
+            for (int y = y0; y < y1; ++y) {
+                uint32_t * row = m_pixels + y * m_pitch;
+
+                if (untouched) {
+                    std::fill(row + x0, row + x1, 0);
+                    continue;
+                }
+
+                // the tile's depth was cleared before it was drawn to
+                for (int x = x0; x < x1; ++x) {
+                    if (is_depth_cleared(x + y * m_width)) {
+                        row[x] = 0;
+                    }
+                }
+            }
+        }
     }
 
-    m_depthBuffer = new float[m_width * m_height];
-    m_buffer = new uint8_t[m_width * m_height * 4];
+    m_color_cleared = true;
 }
 
-bool GraphicsContext::set_depth(unsigned int x, unsigned int y, float depth) {
-    int index = x + y * m_width;
+template<depth_format_t format> inline void GraphicsContext::clear_depth_tile(unsigned int tile_x, unsigned int tile_y) {
+    const int x0 = tile_x * depth_tile_size, x1 = std::min(x0 + (int)depth_tile_size, (int)m_width);
+    const int y0 = tile_y * depth_tile_size, y1 = std::min(y0 + (int)depth_tile_size, (int)m_height);
 
-    if (depth < m_depthBuffer[index]) {
-        m_depthBuffer[index] = depth;
-        return true;
+    for (int y = y0; y < y1; ++y) {
+        if (format == depth_format_t::float32) {
+            std::fill(m_depthBuffer + y * m_width + x0, m_depthBuffer + y * m_width + x1, std::numeric_limits<float>::max());
+        } else if (format == depth_format_t::reversed_float32) {
+            std::fill(m_depthBuffer + y * m_width + x0, m_depthBuffer + y * m_width + x1, 0.0f);
+        } else {
+            uint16_t * row = reinterpret_cast<uint16_t*>(m_depthBuffer) + y * m_width;
+            std::fill(row + x0, row + x1, 0);
+        }
+    }
+}
+
+// 0 is left for cleared pixels, z is at most 1 in front of the near plane
+inline uint16_t GraphicsContext::depth_unorm16(float z) {
+    return (uint16_t)std::min(z * 65534.0f + 1.0f, 65535.0f);
+}
+
+template<depth_format_t format> inline bool GraphicsContext::test_depth_pixel(int index, float z, float depth) {
+    if (format == depth_format_t::float32) {
+        return depth < m_depthBuffer[index];
+    } else if (format == depth_format_t::reversed_float32) {
+        return z > m_depthBuffer[index];
+    } else {
+        return depth_unorm16(z) > reinterpret_cast<const uint16_t*>(m_depthBuffer)[index];
     }
+}
 
-    return false;
+template<depth_format_t format> inline void GraphicsContext::write_depth_pixel(int index, float z, float depth) {
+    if (format == depth_format_t::float32) {
+        m_depthBuffer[index] = depth;
+    } else if (format == depth_format_t::reversed_float32) {
+        m_depthBuffer[index] = z;
+    } else {
+        reinterpret_cast<uint16_t*>(m_depthBuffer)[index] = depth_unorm16(z);
+    }
 }
 
 // graphics drawing
 void GraphicsContext::set_pixel(unsigned int x, unsigned int y, const color_t& color) {
-    unsigned int index = (x + (y * m_width)) * 4;
+    // nothing tells drawn and undrawn pixels apart without depth, so the
+    // pending clear has to happen before the first pixel drawn this way
+    if (!m_color_cleared) {
+        clear_untouched();
+    }
 
-    m_buffer[index + 3] = color.a;
-    m_buffer[index + 2] = color.r;
-    m_buffer[index + 1] = color.g;
-    m_buffer[index + 0] = color.b;
+    m_pixels[x + y * m_pitch] = color.to_argb();
 }
 
 void GraphicsContext::set_pixel_s(unsigned int x, unsigned int y, const color_t& color) {
@@ -157,20 +336,782 @@ void GraphicsContext::draw_line(int x0, int y0, int x1, int y1, const color_t& c
     }
 }
 
-void GraphicsContext::render_text(int x, int y, const char * text) {
-    SDL_Surface * surface;
-    SDL_Texture * texture;
+void GraphicsContext::draw_triangle(const raster_triangle_t& triangle) {
+    if (triangle.min_x >= triangle.max_x || triangle.min_y >= triangle.max_y) {
+        m_stats.triangles_degenerate++;
+        return;
+    }
+
+    triangle_setup_t setup;
+    if (!setup_triangle(triangle, setup)) {
+        m_stats.triangles_degenerate++;
+        return;
+    }
+
+    m_stats.triangles_rasterized++;
+
+    if (!m_threaded) {
+        if (!m_deferred) {
+            fill_triangle<false>(setup, setup.min_x, setup.max_x, setup.min_y, setup.max_y, m_stats);
+            return;
+        }
+
+        // the resolve pass on flush needs the triangle again
+        setup.id = m_triangles.size() + 1;
+        m_triangles.push_back(setup);
+        fill_triangle<true>(setup, setup.min_x, setup.max_x, setup.min_y, setup.max_y, m_stats);
+        return;
+    }
+
+    // bin the triangle into every tile its bounding box touches
+    const unsigned int index = m_triangles.size();
+    setup.id = index + 1;
+    m_triangles.push_back(setup);
+
+    const unsigned int tile_min_x = setup.min_x / tile_size;
+    const unsigned int tile_max_x = (setup.max_x - 1) / tile_size;
+    const unsigned int tile_min_y = setup.min_y / tile_size;
+    const unsigned int tile_max_y = (setup.max_y - 1) / tile_size;
+
+    for (unsigned int ty = tile_min_y; ty <= tile_max_y; ++ty) {
+        for (unsigned int tx = tile_min_x; tx <= tile_max_x; ++tx) {
+            m_tile_bins[ty * m_tiles_x + tx].push_back(index);
+        }
+    }
+}
+
+void GraphicsContext::render_tile(std::size_t tile) {
+    const int tile_x = (tile % m_tiles_x) * tile_size;
+    const int tile_y = (tile / m_tiles_x) * tile_size;
+    const int tile_max_x = std::min(tile_x + (int)tile_size, (int)m_width);
+    const int tile_max_y = std::min(tile_y + (int)tile_size, (int)m_height);
+
+    // counted locally, tiles next to each other are rendered by different threads
+    pipeline_stats_t stats;
+
+    // triangles are stored in submission order, so every pixel sees the same
+    // sequence of depth tests and writes as in the serial path
+    for (unsigned int index : m_tile_bins[tile]) {
+        const triangle_setup_t& setup = m_triangles[index];
+
+        const int min_x = std::max(setup.min_x, tile_x), max_x = std::min(setup.max_x, tile_max_x);
+        const int min_y = std::max(setup.min_y, tile_y), max_y = std::min(setup.max_y, tile_max_y);
+
+        if (m_deferred) {
+            fill_triangle<true>(setup, min_x, max_x, min_y, max_y, stats);
+        } else {
+            fill_triangle<false>(setup, min_x, max_x, min_y, max_y, stats);
+        }
+    }
+
+    // the tile is still in cache, resolve it right away
+    if (m_deferred && !m_tile_bins[tile].empty()) {
+        resolve(tile_x, tile_max_x, tile_y, tile_max_y, stats);
+    }
+
+    m_tile_stats[tile] = stats;
+}
+
+inline int GraphicsContext::select_level(const triangle_setup_t& setup, int x, int y) {
+    const Texture& texture = *setup.texture;
+
+    // one level per span of 8 pixels aligned to the screen grid, taken at its middle so
+    // every path picks the same one. the middle may lie outside the triangle, so 1/z is
+    // kept inside the triangle's range like at the block corners
+    const float dx = (x & ~7) + 3.5f - setup.origin_x;
+    const float dy = y - setup.origin_y;
+    const float z = std::min(std::max(setup.za * dx + setup.zb * dy + setup.zc, setup.z_min), setup.z_max);
+    const float z2 = z * z;
+
+    const float du_dx = setup.dudx_b * dy + setup.dudx_c;
+    const float dv_dx = setup.dvdx_b * dy + setup.dvdx_c;
+    const float du_dy = setup.dudy_a * dx + setup.dudy_c;
+    const float dv_dy = setup.dvdy_a * dx + setup.dvdy_c;
+    const float rho_z4 = std::max(du_dx * du_dx + dv_dx * dv_dx, du_dy * du_dy + dv_dy * dv_dy);
+    const float z4 = z2 * z2;
+
+    // level = floor(log2(sqrt(rho))) with rho = rho_z4 / z4, the difference of the float
+    // exponents is floor(log2(rho)) or one more, which the mantissas settle, so no divide
+    uint32_t rho_bits, z_bits;
+    std::memcpy(&rho_bits, &rho_z4, sizeof(rho_bits));
+    std::memcpy(&z_bits, &z4, sizeof(z_bits));
+    const int log2_rho = (int)(rho_bits >> 23) - (int)(z_bits >> 23) - ((rho_bits & 0x7fffff) < (z_bits & 0x7fffff));
+    return std::min(std::max(log2_rho >> 1, 0), (int)texture.get_num_levels() - 1);
+}
+
+inline uint32_t GraphicsContext::sample_texture(const triangle_setup_t& setup, float u, float v, int level) {
+    const Texture& texture = *setup.texture;
+    const Texture::levels_t& levels = texture.get_levels();
+
+    // power of two sizes, wrapping is a mask
+    const int tex_width = levels.width[level];
+    const int tex_height = levels.height[level];
+    const unsigned int x = ((int)(u * tex_width)) & (tex_width - 1);
+    const unsigned int y = ((int)(v * tex_height)) & (tex_height - 1);
+
+    // texels are already in the framebuffer's format
+    const uint32_t * texels = texture.get_texels() + levels.offset[level];
+    return texels[Texture::get_texel_index(x, y, levels.tiles_shift[level])];
+}
+
+#if defined(__AVX2__)
+// samples the texture at the eight pixels from (x, y) on and writes them to the color buffer, at pixels
+inline void GraphicsContext::shade_pixels(const triangle_setup_t& setup, uint32_t * pixels, int x, int y, __m256 u, __m256 v, __m256i mask) {
+    const Texture& texture = *setup.texture;
+    const Texture::levels_t& levels = texture.get_levels();
+    const int * tex_buffer = reinterpret_cast<const int*>(texture.get_texels());
+
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i three = _mm256_set1_epi32(3);
+
+    // an unaligned span covers two of the aligned spans the level is picked for, lanes
+    // from split on belong to the second one. a level no lane needs is not computed
+    const int split = 8 - (x & 7);
+    const int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+    const int first_level = (lanes & ((1 << split) - 1)) ? select_level(setup, x, y) : 0;
+    const int second_level = (lanes >> split) ? select_level(setup, x + 8, y) : first_level;
+
+    __m256i offset = _mm256_set1_epi32(levels.offset[first_level]);
+    __m256i width = _mm256_set1_epi32(levels.width[first_level]);
+    __m256i height = _mm256_set1_epi32(levels.height[first_level]);
+    __m256i tiles_shift = _mm256_set1_epi32(levels.tiles_shift[first_level]);
+
+    if (second_level != first_level) {
+        const __m256i second = _mm256_cmpgt_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(split - 1));
+        offset = _mm256_blendv_epi8(offset, _mm256_set1_epi32(levels.offset[second_level]), second);
+        width = _mm256_blendv_epi8(width, _mm256_set1_epi32(levels.width[second_level]), second);
+        height = _mm256_blendv_epi8(height, _mm256_set1_epi32(levels.height[second_level]), second);
+        tiles_shift = _mm256_blendv_epi8(tiles_shift, _mm256_set1_epi32(levels.tiles_shift[second_level]), second);
+    }
+
+    // power of two sizes, wrapping is a mask
+    __m256i tx = _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_cvtepi32_ps(width)));
+    __m256i ty = _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_cvtepi32_ps(height)));
+    tx = _mm256_and_si256(tx, _mm256_sub_epi32(width, one));
+    ty = _mm256_and_si256(ty, _mm256_sub_epi32(height, one));
+
+    // same as Texture::get_texel_index, the tile then the texel inside the 4x4 tile
+    const __m256i tile = _mm256_or_si256(_mm256_sllv_epi32(_mm256_srli_epi32(ty, 2), tiles_shift), _mm256_srli_epi32(tx, 2));
+    const __m256i texel_index = _mm256_add_epi32(offset, _mm256_or_si256(
+        _mm256_slli_epi32(tile, 4),
+        _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(ty, three), 2), _mm256_and_si256(tx, three))));
+
+    // texels are already in the framebuffer's format
+    const __m256i color = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), tex_buffer, texel_index, mask, 4);
+
+    _mm256_maskstore_epi32(reinterpret_cast<int*>(pixels), mask, color);
+}
+
+inline __m256i GraphicsContext::depth_unorm16(__m256 z) {
+    return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_fmadd_ps(z, _mm256_set1_ps(65534.0f), _mm256_set1_ps(1.0f)), _mm256_set1_ps(65535.0f)));
+}
+
+template<depth_format_t format> inline __m256 GraphicsContext::test_depth_pixels(int index, int count, __m256 z, __m256 depth, __m256 mask) {
+    if (format == depth_format_t::float32) {
+        const __m256 old_depth = _mm256_maskload_ps(m_depthBuffer + index, _mm256_castps_si256(mask));
+        return _mm256_and_ps(mask, _mm256_cmp_ps(depth, old_depth, _CMP_LT_OQ));
+    } else if (format == depth_format_t::reversed_float32) {
+        const __m256 old_z = _mm256_maskload_ps(m_depthBuffer + index, _mm256_castps_si256(mask));
+        return _mm256_and_ps(mask, _mm256_cmp_ps(z, old_z, _CMP_GT_OQ));
+    }
+
+    // there are no masked 16 bit loads, lanes past the span may belong to another thread's tile
+    const uint16_t * buffer = reinterpret_cast<const uint16_t*>(m_depthBuffer) + index;
+    __m256i old_keys;
+
+    if (count >= 8) {
+        old_keys = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer)));
+    } else {
+        alignas(32) int32_t keys[8] = { };
+        for (int i = 0; i < count; ++i) {
+            keys[i] = buffer[i];
+        }
+        old_keys = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys));
+    }
+
+    return _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_cmpgt_epi32(depth_unorm16(z), old_keys)));
+}
+
+template<depth_format_t format> inline void GraphicsContext::write_depth_pixels(int index, int count, __m256 z, __m256 depth, __m256i mask) {
+    if (format == depth_format_t::float32) {
+        _mm256_maskstore_ps(m_depthBuffer + index, mask, depth);
+        return;
+    } else if (format == depth_format_t::reversed_float32) {
+        _mm256_maskstore_ps(m_depthBuffer + index, mask, z);
+        return;
+    }
+
+    uint16_t * buffer = reinterpret_cast<uint16_t*>(m_depthBuffer) + index;
+    const __m256i keys = depth_unorm16(z);
+
+    if (count >= 8) {
+        // narrow keys and mask to 16 bits and blend them into the old values
+        const __m128i keys_16 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(keys, keys), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m128i mask_16 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packs_epi32(mask, mask), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m128i old_keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_blendv_epi8(old_keys, keys_16, mask_16));
+    } else {
+        alignas(32) int32_t lane_keys[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lane_keys), keys);
+
+        const int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+        for (int i = 0; i < count; ++i) {
+            if (lanes & (1 << i)) {
+                buffer[i] = lane_keys[i];
+            }
+        }
+    }
+}
+#endif
+
+inline GraphicsContext::edge_t GraphicsContext::setup_edge(int64_t ax, int64_t ay, int64_t bx, int64_t by, int origin_x, int origin_y) {
+    edge_t edge;
+
+    // value at the center of the origin pixel and steps per whole pixel, all in 1/256 px^2
+    const int64_t px = origin_x * subpixel_scale + subpixel_scale / 2;
+    const int64_t py = origin_y * subpixel_scale + subpixel_scale / 2;
+
+    edge.a = (by - ay) * subpixel_scale;
+    edge.b = (ax - bx) * subpixel_scale;
+    edge.c = (px - ax) * (by - ay) - (py - ay) * (bx - ax);
+
+    // top-left fill rule, pixel centers exactly on an edge belong to the triangle
+    // only if it is a left edge or a top edge, so shared edges are rasterized once
+    const bool top_left = (by - ay) > 0 || ((by - ay) == 0 && (ax - bx) > 0);
+    edge.bias = top_left ? 0 : -1;
+
+    return edge;
+}
+
+bool GraphicsContext::setup_triangle(const raster_triangle_t& raster_triangle, triangle_setup_t& setup) {
+    const triangle_t& triangle = raster_triangle.triangle;
+
+    // snap vertices to 28.4 fixed point
+    const int64_t x1 = llrintf(triangle.v1.pos[0] * subpixel_scale), y1 = llrintf(triangle.v1.pos[1] * subpixel_scale);
+    const int64_t x2 = llrintf(triangle.v2.pos[0] * subpixel_scale), y2 = llrintf(triangle.v2.pos[1] * subpixel_scale);
+    const int64_t x3 = llrintf(triangle.v3.pos[0] * subpixel_scale), y3 = llrintf(triangle.v3.pos[1] * subpixel_scale);
+
+    const int64_t area = (x3 - x1) * (y2 - y1) - (y3 - y1) * (x2 - x1);
+    if (area <= 0) {
+        return false;
+    }
+
+    setup.texture = raster_triangle.texture;
+    setup.id = 0;
+
+    setup.min_x = raster_triangle.min_x;
+    setup.max_x = raster_triangle.max_x;
+    setup.min_y = raster_triangle.min_y;
+    setup.max_y = raster_triangle.max_y;
+
+    // all equations are relative to the corner of the triangle bounding box (not the
+    // clipped box), so every tile evaluates them exactly the same way
+    setup.origin_x = raster_triangle.min_x;
+    setup.origin_y = raster_triangle.min_y;
+
+    const edge_t& e1 = setup.e1 = setup_edge(x2, y2, x3, y3, setup.origin_x, setup.origin_y);
+    const edge_t& e2 = setup.e2 = setup_edge(x3, y3, x1, y1, setup.origin_x, setup.origin_y);
+    const edge_t& e3 = setup.e3 = setup_edge(x1, y1, x2, y2, setup.origin_x, setup.origin_y);
+
+    // 1/z, u/z and v/z are affine in screen space, so they can be stepped the same way,
+    // barycentric weights are the edge values divided by the area
+    const float inv_area = 1.0f / area;
+    const float a1 = e1.a * inv_area, b1 = e1.b * inv_area, c1 = e1.c * inv_area;
+    const float a2 = e2.a * inv_area, b2 = e2.b * inv_area, c2 = e2.c * inv_area;
+    const float a3 = e3.a * inv_area, b3 = e3.b * inv_area, c3 = e3.c * inv_area;
+
+    const float z1 = triangle.v1.pos[2], z2 = triangle.v2.pos[2], z3 = triangle.v3.pos[2];
+    const float uz1 = triangle.v1.u * z1, uz2 = triangle.v2.u * z2, uz3 = triangle.v3.u * z3;
+    const float vz1 = triangle.v1.v * z1, vz2 = triangle.v2.v * z2, vz3 = triangle.v3.v * z3;
+
+    setup.za = a1 * z1 + a2 * z2 + a3 * z3;
+    setup.zb = b1 * z1 + b2 * z2 + b3 * z3;
+    setup.zc = c1 * z1 + c2 * z2 + c3 * z3;
+
+    setup.ua = a1 * uz1 + a2 * uz2 + a3 * uz3;
+    setup.ub = b1 * uz1 + b2 * uz2 + b3 * uz3;
+    setup.uc = c1 * uz1 + c2 * uz2 + c3 * uz3;
+
+    setup.va = a1 * vz1 + a2 * vz2 + a3 * vz3;
+    setup.vb = b1 * vz1 + b2 * vz2 + b3 * vz3;
+    setup.vc = c1 * vz1 + c2 * vz2 + c3 * vz3;
+
+    // range of 1/z over the triangle, bounds the values extrapolated to block corners
+    setup.z_min = std::min({ z1, z2, z3 });
+    setup.z_max = std::max({ z1, z2, z3 });
+
+    // u = (u/z) / (1/z) so du/dx = (ua * (1/z) - za * (u/z)) / (1/z)^2, the x terms of the
+    // numerator cancel so it only varies with y, and the one of du/dy only with x
+    const Texture::levels_t& levels = setup.texture->get_levels();
+    const float tex_width = levels.width[0], tex_height = levels.height[0];
+
+    setup.dudx_b = (setup.ua * setup.zb - setup.za * setup.ub) * tex_width;
+    setup.dudx_c = (setup.ua * setup.zc - setup.za * setup.uc) * tex_width;
+    setup.dvdx_b = (setup.va * setup.zb - setup.za * setup.vb) * tex_height;
+    setup.dvdx_c = (setup.va * setup.zc - setup.za * setup.vc) * tex_height;
+    setup.dudy_a = (setup.ub * setup.za - setup.zb * setup.ua) * tex_width;
+    setup.dudy_c = (setup.ub * setup.zc - setup.zb * setup.uc) * tex_width;
+    setup.dvdy_a = (setup.vb * setup.za - setup.zb * setup.va) * tex_height;
+    setup.dvdy_c = (setup.vb * setup.zc - setup.zb * setup.vc) * tex_height;
+
+    return true;
+}
+
+template<bool deferred> void GraphicsContext::fill_triangle(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats) {
+    switch (m_depth_format) {
+        case depth_format_t::reversed_float32:
+            fill_blocks<depth_format_t::reversed_float32, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+            break;
+        case depth_format_t::unorm16:
+            fill_blocks<depth_format_t::unorm16, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+            break;
+        default:
+            fill_blocks<depth_format_t::float32, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+            break;
+    }
+}
+
+template<depth_format_t format, bool deferred> void GraphicsContext::fill_blocks(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats) {
+    if (m_block_size == 0) {
+        fill_coarse_block<format, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+        return;
+    }
+
+    // coarse pass over blocks aligned to the screen grid
+    const int block = m_block_size;
+
+    for (int block_y = min_y - min_y % block; block_y < max_y; block_y += block) {
+        const int block_min_y = std::max(block_y, min_y);
+        const int block_max_y = std::min(block_y + block, max_y);
+
+        for (int block_x = min_x - min_x % block; block_x < max_x; block_x += block) {
+            const int block_min_x = std::max(block_x, min_x);
+            const int block_max_x = std::min(block_x + block, max_x);
+
+            fill_coarse_block<format, deferred>(setup, block_min_x, block_max_x, block_min_y, block_max_y, stats);
+        }
+    }
+}
+
+template<depth_format_t format, bool deferred> inline void GraphicsContext::fill_coarse_block(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats) {
+    const int64_t dx = min_x - setup.origin_x;
+    const int64_t dy = min_y - setup.origin_y;
+    const int64_t last_dx = max_x - min_x - 1;
+    const int64_t last_dy = max_y - min_y - 1;
+
+    // the block is classified by its corner pixels: blocks outside any edge are skipped,
+    // blocks inside all of them are filled without edge tests and only the rest is
+    // tested per pixel
+    bool inside = true;
+    bool outside = false;
+
+    for (const edge_t * edge : { &setup.e1, &setup.e2, &setup.e3 }) {
+        const int64_t w = edge->at(dx, dy);
+        const int64_t step_x = edge->a * last_dx;
+        const int64_t step_y = edge->b * last_dy;
+
+        const int64_t w_min = w + std::min<int64_t>(step_x, 0) + std::min<int64_t>(step_y, 0);
+        const int64_t w_max = w + std::max<int64_t>(step_x, 0) + std::max<int64_t>(step_y, 0);
+
+        outside = outside || w_max < 0;
+        inside = inside && w_min >= 0;
+    }
+
+    if (outside) {
+        return;
+    }
+
+    // depth range of the triangle inside the block, 1/z is affine so its extremes are at the
+    // corners, widened a little so rounding in the per pixel path can not disagree with it
+    const float z = setup.za * dx + setup.zb * dy + setup.zc;
+    const float z_step_x = setup.za * last_dx;
+    const float z_step_y = setup.zb * last_dy;
+
+    const float z_min = std::max(setup.z_min, z + std::min(z_step_x, 0.0f) + std::min(z_step_y, 0.0f));
+    const float z_max = std::min(setup.z_max, z + std::max(z_step_x, 0.0f) + std::max(z_step_y, 0.0f));
+
+    const float depth_near = (1.0f - depth_epsilon) / z_max;
+    const float depth_far = (1.0f + depth_epsilon) / z_min;
+
+    // hierarchical depth test against every depth tile the block touches
+    const unsigned int tile_min_x = min_x / depth_tile_size, tile_max_x = (max_x - 1) / depth_tile_size;
+    const unsigned int tile_min_y = min_y / depth_tile_size, tile_max_y = (max_y - 1) / depth_tile_size;
+
+    float tiles_near = std::numeric_limits<float>::max();
+    float tiles_far = 0.0f;
+
+    for (unsigned int ty = tile_min_y; ty <= tile_max_y; ++ty) {
+        for (unsigned int tx = tile_min_x; tx <= tile_max_x; ++tx) {
+            tiles_near = std::min(tiles_near, m_depth_tile_min[ty * m_depth_tiles_x + tx]);
+            tiles_far = std::max(tiles_far, m_depth_tile_max[ty * m_depth_tiles_x + tx]);
+        }
+    }
+
+    if (depth_near >= tiles_far) {
+        stats.blocks_hiz_culled++;
+        return; // hidden behind everything already drawn there
+    }
+
+    // when the whole block is in front of everything drawn there the per pixel depth test always passes
+    const bool test_depth = !(depth_far < tiles_near);
+
+    // untouched depth tiles are cleared before the block reads them, unless the block
+    // writes all of their pixels without reading any
+    for (unsigned int ty = tile_min_y; ty <= tile_max_y; ++ty) {
+        for (unsigned int tx = tile_min_x; tx <= tile_max_x; ++tx) {
+            if (m_depth_tile_min[ty * m_depth_tiles_x + tx] != std::numeric_limits<float>::max()) {
+                continue;
+            }
+
+            const int x0 = tx * depth_tile_size, x1 = std::min(x0 + (int)depth_tile_size, (int)m_width);
+            const int y0 = ty * depth_tile_size, y1 = std::min(y0 + (int)depth_tile_size, (int)m_height);
+            const bool covered = x0 >= min_x && x1 <= max_x && y0 >= min_y && y1 <= max_y;
+
+            if (!(inside && !test_depth && covered)) {
+                clear_depth_tile<format>(tx, ty);
+            }
+        }
+    }
+
+    if (inside && test_depth) {
+        fill_block<format, false, true, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+    } else if (inside) {
+        fill_block<format, false, false, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+    } else if (test_depth) {
+        fill_block<format, true, true, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+    } else {
+        fill_block<format, true, false, deferred>(setup, min_x, max_x, min_y, max_y, stats);
+    }
+
+    update_depth_tiles<format>(min_x, max_x, min_y, max_y, depth_near, depth_far, inside && !test_depth);
+}
+
+template<depth_format_t format> inline void GraphicsContext::update_depth_tiles(const int min_x, const int max_x, const int min_y, const int max_y, float depth_near, float depth_far, bool overwritten) {
+    const unsigned int tile_min_x = min_x / depth_tile_size, tile_max_x = (max_x - 1) / depth_tile_size;
+    const unsigned int tile_min_y = min_y / depth_tile_size, tile_max_y = (max_y - 1) / depth_tile_size;
+
+    for (unsigned int ty = tile_min_y; ty <= tile_max_y; ++ty) {
+        for (unsigned int tx = tile_min_x; tx <= tile_max_x; ++tx) {
+            const unsigned int tile = ty * m_depth_tiles_x + tx;
+
+            const int x0 = tx * depth_tile_size, x1 = std::min(x0 + (int)depth_tile_size, (int)m_width);
+            const int y0 = ty * depth_tile_size, y1 = std::min(y0 + (int)depth_tile_size, (int)m_height);
+
+            // everything written is nearer than the old values and no nearer than the block
+            m_depth_tile_min[tile] = std::min(m_depth_tile_min[tile], depth_near);
+
+            // the far bound can only shrink when the block covers the whole tile, partially
+            // covered tiles keep their old (still valid) bound
+            if (x0 < min_x || x1 > max_x || y0 < min_y || y1 > max_y) {
+                continue;
+            }
 
-    surface = TTF_RenderText_Solid(m_font, text, {255, 255, 255, SDL_ALPHA_OPAQUE});
-    texture = SDL_CreateTextureFromSurface(m_renderer, surface);
+            if (overwritten) {
+                // every pixel of the tile was written, no need to look at the buffer
+                m_depth_tile_min[tile] = depth_near;
+                m_depth_tile_max[tile] = depth_far;
+                continue;
+            }
 
-    SDL_Rect rect;
-    rect.x = x;
-    rect.y = y;
-    rect.w = surface->w;
-    rect.h = surface->h;
+            if (format == depth_format_t::float32) {
+                float tile_far = 0.0f;
+                for (int y = y0; y < y1; ++y) {
+                    const float * row = m_depthBuffer + y * m_width;
+
+                    for (int x = x0; x < x1; ++x) {
+                        tile_far = std::max(tile_far, row[x]);
+                    }
+                }
+
+                m_depth_tile_max[tile] = tile_far;
+            } else if (format == depth_format_t::reversed_float32) {
+                float tile_z = std::numeric_limits<float>::max();
+                for (int y = y0; y < y1; ++y) {
+                    const float * row = m_depthBuffer + y * m_width;
+
+                    for (int x = x0; x < x1; ++x) {
+                        tile_z = std::min(tile_z, row[x]);
+                    }
+                }
+
+                m_depth_tile_max[tile] = tile_z > 0.0f ? 1.0f / tile_z : std::numeric_limits<float>::max();
+            } else {
+                unsigned int tile_key = 65535;
+                for (int y = y0; y < y1; ++y) {
+                    const uint16_t * row = reinterpret_cast<const uint16_t*>(m_depthBuffer) + y * m_width;
+
+                    for (int x = x0; x < x1; ++x) {
+                        tile_key = std::min<unsigned int>(tile_key, row[x]);
+                    }
+                }
+
+                // the farthest depth a stored value can stand for, so the bound stays conservative
+                m_depth_tile_max[tile] = tile_key > 1 ? 65534.0f / (tile_key - 1) : std::numeric_limits<float>::max();
+            }
+        }
+    }
+}
 
-    SDL_RenderCopy(m_renderer, texture, nullptr, &rect);
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
-}
\ No newline at end of file
+template<depth_format_t format, bool test_edges, bool test_depth, bool deferred> inline void GraphicsContext::fill_block(const triangle_setup_t& setup, const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats) {
+    const edge_t& e1 = setup.e1;
+    const edge_t& e2 = setup.e2;
+    const edge_t& e3 = setup.e3;
+    const int origin_x = setup.origin_x;
+    const int origin_y = setup.origin_y;
+
+#if defined(__AVX2__)
+    const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256i lane_i = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i id = _mm256_set1_epi32(setup.id);
+
+    // the edge values do not fit in 32 bits for triangles far outside the screen,
+    // so they are stepped exactly as 64 bit integers, four pixels per register
+    const __m256i e1_lo = _mm256_setr_epi64x(0, e1.a, 2 * e1.a, 3 * e1.a), e1_hi = _mm256_add_epi64(e1_lo, _mm256_set1_epi64x(4 * e1.a));
+    const __m256i e2_lo = _mm256_setr_epi64x(0, e2.a, 2 * e2.a, 3 * e2.a), e2_hi = _mm256_add_epi64(e2_lo, _mm256_set1_epi64x(4 * e2.a));
+    const __m256i e3_lo = _mm256_setr_epi64x(0, e3.a, 2 * e3.a, 3 * e3.a), e3_hi = _mm256_add_epi64(e3_lo, _mm256_set1_epi64x(4 * e3.a));
+    const __m256i e1_step = _mm256_set1_epi64x(e1.a * 8);
+    const __m256i e2_step = _mm256_set1_epi64x(e2.a * 8);
+    const __m256i e3_step = _mm256_set1_epi64x(e3.a * 8);
+
+    const __m256 za_v = _mm256_set1_ps(setup.za), ua_v = _mm256_set1_ps(setup.ua), va_v = _mm256_set1_ps(setup.va);
+
+    // covered pixels and the ones of them that passed the depth test
+    unsigned int covered = 0, passed = 0;
+
+    // edge values at the first pixel of the current row
+    int64_t w1_row = e1.at(min_x - origin_x, min_y - origin_y);
+    int64_t w2_row = e2.at(min_x - origin_x, min_y - origin_y);
+    int64_t w3_row = e3.at(min_x - origin_x, min_y - origin_y);
+
+    for (int y = min_y; y < max_y; ++y, w1_row += e1.b, w2_row += e2.b, w3_row += e3.b) {
+        const float dy = y - origin_y;
+
+        __m256i w1_lo = _mm256_add_epi64(_mm256_set1_epi64x(w1_row), e1_lo), w1_hi = _mm256_add_epi64(_mm256_set1_epi64x(w1_row), e1_hi);
+        __m256i w2_lo = _mm256_add_epi64(_mm256_set1_epi64x(w2_row), e2_lo), w2_hi = _mm256_add_epi64(_mm256_set1_epi64x(w2_row), e2_hi);
+        __m256i w3_lo = _mm256_add_epi64(_mm256_set1_epi64x(w3_row), e3_lo), w3_hi = _mm256_add_epi64(_mm256_set1_epi64x(w3_row), e3_hi);
+
+        const __m256 z_row = _mm256_set1_ps(setup.zb * dy + setup.zc);
+        const __m256 u_row = _mm256_set1_ps(setup.ub * dy + setup.uc);
+        const __m256 v_row = _mm256_set1_ps(setup.vb * dy + setup.vc);
+
+        for (int x = min_x; x < max_x; x += 8) {
+            // lanes past the end of the span are masked out, masked loads and stores never touch them
+            __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(max_x - x), lane_i));
+
+            if (test_edges) {
+                // a pixel is outside if any of its edge values is negative, gather the sign
+                // bits of the eight 64 bit lanes into eight 32 bit lanes in pixel order
+                const __m256i outside_lo = _mm256_or_si256(_mm256_or_si256(w1_lo, w2_lo), w3_lo);
+                const __m256i outside_hi = _mm256_or_si256(_mm256_or_si256(w1_hi, w2_hi), w3_hi);
+
+                __m256i outside = _mm256_castps_si256(_mm256_shuffle_ps(
+                    _mm256_castsi256_ps(outside_lo), _mm256_castsi256_ps(outside_hi), _MM_SHUFFLE(3, 1, 3, 1)));
+                outside = _mm256_srai_epi32(_mm256_permute4x64_epi64(outside, _MM_SHUFFLE(3, 1, 2, 0)), 31);
+
+                w1_lo = _mm256_add_epi64(w1_lo, e1_step); w1_hi = _mm256_add_epi64(w1_hi, e1_step);
+                w2_lo = _mm256_add_epi64(w2_lo, e2_step); w2_hi = _mm256_add_epi64(w2_hi, e2_step);
+                w3_lo = _mm256_add_epi64(w3_lo, e3_step); w3_hi = _mm256_add_epi64(w3_hi, e3_step);
+
+                mask = _mm256_andnot_ps(_mm256_castsi256_ps(outside), mask);
+            }
+
+            int lanes = _mm256_movemask_ps(mask);
+            if (lanes == 0) {
+                continue;
+            }
+
+            covered += std::bitset<8>(lanes).count();
+
+            const __m256 dx = _mm256_add_ps(_mm256_set1_ps(x - origin_x), lane);
+            const int index = x + y * m_width;
+            const __m256 z = _mm256_fmadd_ps(za_v, dx, z_row);
+            const __m256 depth = _mm256_div_ps(one, z);
+
+            if (test_depth) {
+                mask = test_depth_pixels<format>(index, max_x - x, z, depth, mask);
+                lanes = _mm256_movemask_ps(mask);
+
+                if (lanes == 0) {
+                    continue;
+                }
+            }
+
+            passed += std::bitset<8>(lanes).count();
+
+            const __m256i mask_i = _mm256_castps_si256(mask);
+            write_depth_pixels<format>(index, max_x - x, z, depth, mask_i);
+
+            if (deferred) {
+                // texturing waits for the resolve pass, only remember which triangle won
+                _mm256_maskstore_epi32(reinterpret_cast<int*>(m_visibilityBuffer + index), mask_i, id);
+                continue;
+            }
+
+            // perspective corrected interpolation
+            const __m256 u = _mm256_mul_ps(depth, _mm256_fmadd_ps(ua_v, dx, u_row));
+            const __m256 v = _mm256_mul_ps(depth, _mm256_fmadd_ps(va_v, dx, v_row));
+
+            shade_pixels(setup, m_pixels + x + y * m_pitch, x, y, u, v, mask_i);
+        }
+    }
+#else
+    unsigned int covered = 0, passed = 0;
+
+    // edge values at the first pixel of the current row
+    int64_t w1_row = e1.at(min_x - origin_x, min_y - origin_y);
+    int64_t w2_row = e2.at(min_x - origin_x, min_y - origin_y);
+    int64_t w3_row = e3.at(min_x - origin_x, min_y - origin_y);
+
+    for (int y = min_y; y < max_y; ++y, w1_row += e1.b, w2_row += e2.b, w3_row += e3.b) {
+        const float dy = y - origin_y;
+
+        int64_t w1 = w1_row;
+        int64_t w2 = w2_row;
+        int64_t w3 = w3_row;
+
+        const float z_row = setup.zb * dy + setup.zc;
+        const float u_row = setup.ub * dy + setup.uc;
+        const float v_row = setup.vb * dy + setup.vc;
+
+        // mip level of the aligned span of 8 pixels the last sample fell in
+        int level_span = -1, level = 0;
+
+        for (int x = min_x; x < max_x; ++x, w1 += e1.a, w2 += e2.a, w3 += e3.a) {
+            if (!test_edges || (w1 | w2 | w3) >= 0) {
+                const float dx = x - origin_x;
+                const float z = setup.za * dx + z_row;
+                const float depth = 1.0f / z;
+                const int index = x + y * m_width;
+
+                covered++;
+
+                if (!test_depth || test_depth_pixel<format>(index, z, depth)) {
+                    write_depth_pixel<format>(index, z, depth);
+                    passed++;
+
+                    if (deferred) {
+                        m_visibilityBuffer[index] = setup.id;
+                        continue;
+                    }
+
+                    // perspective corrected interpolation
+                    float u = depth * (setup.ua * dx + u_row);
+                    float v = depth * (setup.va * dx + v_row);
+
+                    if ((x >> 3) != level_span) {
+                        level_span = x >> 3;
+                        level = select_level(setup, x, y);
+                    }
+
+                    m_pixels[x + y * m_pitch] = sample_texture(setup, u, v, level);
+                }
+            }
+        }
+    }
+#endif
+
+    stats.pixels_tested += (max_x - min_x) * (max_y - min_y);
+    stats.depth_passed += passed;
+    stats.depth_failed += covered - passed;
+
+    if (!deferred) {
+        stats.texture_samples += passed;
+    }
+}
+
+void GraphicsContext::resolve(const int min_x, const int max_x, const int min_y, const int max_y, pipeline_stats_t& stats) {
+    // every visible pixel is textured exactly once here, the ids are reset
+    // as they are consumed so the buffer is empty again for the next frame
+#if defined(__AVX2__)
+    const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256i lane_i = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (int y = min_y; y < max_y; ++y) {
+        for (int x = min_x; x < max_x; x += 8) {
+            const int index = x + y * m_width;
+            const __m256i in_span = _mm256_cmpgt_epi32(_mm256_set1_epi32(max_x - x), lane_i);
+
+            __m256i ids = _mm256_maskload_epi32(reinterpret_cast<const int*>(m_visibilityBuffer + index), in_span);
+            int pending = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(_mm256_cmpeq_epi32(ids, zero), in_span)));
+
+            if (pending == 0) {
+                continue;
+            }
+
+            _mm256_maskstore_epi32(reinterpret_cast<int*>(m_visibilityBuffer + index), in_span, zero);
+            stats.texture_samples += std::bitset<8>(pending).count();
+
+            // neighbouring pixels mostly belong to the same triangle, shade all lanes
+            // of one triangle at a time until every lane is done
+            alignas(32) uint32_t lane_ids[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lane_ids), ids);
+
+            for (int first = 0; pending; ++first) {
+                if (!(pending & (1 << first))) {
+                    continue;
+                }
+
+                const uint32_t id = lane_ids[first];
+                const triangle_setup_t& setup = m_triangles[id - 1];
+
+                const __m256i mask = _mm256_cmpeq_epi32(ids, _mm256_set1_epi32(id));
+                pending = pending & ~_mm256_movemask_ps(_mm256_castsi256_ps(mask));
+
+                const float dy = y - setup.origin_y;
+                const __m256 dx = _mm256_add_ps(_mm256_set1_ps(x - setup.origin_x), lane);
+
+                // the depth buffer may not hold w exactly, so it comes from the plane again
+                const __m256 depth = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_fmadd_ps(_mm256_set1_ps(setup.za), dx, _mm256_set1_ps(setup.zb * dy + setup.zc)));
+
+                // perspective corrected interpolation, same as in the forward path
+                const __m256 u = _mm256_mul_ps(depth, _mm256_fmadd_ps(_mm256_set1_ps(setup.ua), dx, _mm256_set1_ps(setup.ub * dy + setup.uc)));
+                const __m256 v = _mm256_mul_ps(depth, _mm256_fmadd_ps(_mm256_set1_ps(setup.va), dx, _mm256_set1_ps(setup.vb * dy + setup.vc)));
+
+                shade_pixels(setup, m_pixels + x + y * m_pitch, x, y, u, v, mask);
+            }
+        }
+    }
+#else
+    for (int y = min_y; y < max_y; ++y) {
+        // mip level of the last triangle and aligned span of 8 pixels sampled
+        uint32_t level_id = 0;
+        int level_span = -1, level = 0;
+
+        for (int x = min_x; x < max_x; ++x) {
+            const int index = x + y * m_width;
+            const uint32_t id = m_visibilityBuffer[index];
+
+            if (id == 0) {
+                continue;
+            }
+
+            m_visibilityBuffer[index] = 0;
+            stats.texture_samples++;
+
+            const triangle_setup_t& setup = m_triangles[id - 1];
+            const float dx = x - setup.origin_x;
+            const float dy = y - setup.origin_y;
+            const float u_row = setup.ub * dy + setup.uc;
+            const float v_row = setup.vb * dy + setup.vc;
+
+            // the depth buffer may not hold w exactly, so it comes from the plane again
+            const float depth = 1.0f / (setup.za * dx + (setup.zb * dy + setup.zc));
+
+            // perspective corrected interpolation, same as in the forward path
+            float u = depth * (setup.ua * dx + u_row);
+            float v = depth * (setup.va * dx + v_row);
+
+            if (id != level_id || (x >> 3) != level_span) {
+                level_id = id;
+                level_span = x >> 3;
+                level = select_level(setup, x, y);
+            }
+
+            m_pixels[x + y * m_pitch] = sample_texture(setup, u, v, level);
+        }
+    }
+#endif
+}
@@ -2,8 +2,11 @@
 
 #include <thread>
 #include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
 
-Model::Model(std::vector<float> pos, std::vector<unsigned int> ind, std::vector<float> tex, const Texture & texture) {
+Model::Model(std::vector<float> pos, std::vector<unsigned int> ind, std::vector<float> tex, std::shared_ptr<const Texture> texture, std::vector<unsigned int> groups) {
     const unsigned int num_positions = pos.size();
     const unsigned int num_indices = ind.size();
 
@@ -16,194 +19,327 @@ Model::Model(std::vector<float> pos, std::vector<unsigned int> ind, std::vector<
     }
 
     const unsigned int num_edges = num_indices / 3;
-    unsigned int base_index_1, base_index_2, base_index_3;
-    unsigned int tex_index_1, tex_index_2, tex_index_3;
+    unsigned int base_index, tex_index;
 
-    m_triangles.resize(num_edges);
-    m_texture = texture;
+    // positions are indexed but texture coordinates are given per corner, so a
+    // unique vertex is a position index together with its texture coordinate
+    std::map<std::tuple<unsigned int, float, float>, unsigned int> unique;
+
+    m_indices.resize(num_indices);
+    m_texture = std::move(texture);
 
     for (unsigned int i = 0; i < num_edges; ++i) {
-        base_index_1 = 3 * ind[3 * i + 0];
-        base_index_2 = 3 * ind[3 * i + 1];
-        base_index_3 = 3 * ind[3 * i + 2];
+        for (unsigned int k = 0; k < 3; ++k) {
+            base_index = ind[3 * i + k];
+            tex_index = (2 * (3 * i + k)) % tex.size();
+
+            const float u = tex[tex_index + 0];
+            const float v = tex[tex_index + 1];
+
+            auto it = unique.emplace(std::make_tuple(base_index, u, v), m_tex_u.size());
+            if (it.second) {
+                m_positions.x.push_back(pos[3 * base_index + 0]);
+                m_positions.y.push_back(pos[3 * base_index + 1]);
+                m_positions.z.push_back(pos[3 * base_index + 2]);
+                m_tex_u.push_back(u);
+                m_tex_v.push_back(v);
+            }
+
+            m_indices[3 * i + k] = it.first->second;
+        }
+    }
 
-        m_triangles[i].v1.pos.set(pos[base_index_1 + 0], pos[base_index_1 + 1], pos[base_index_1 + 2], 1.0f);
-        m_triangles[i].v2.pos.set(pos[base_index_2 + 0], pos[base_index_2 + 1], pos[base_index_2 + 2], 1.0f);
-        m_triangles[i].v3.pos.set(pos[base_index_3 + 0], pos[base_index_3 + 1], pos[base_index_3 + 2], 1.0f);
+    const unsigned int num_vertices = m_positions.size();
+    if (num_vertices > 0) {
+        vec_t<float> min(m_positions.x[0], m_positions.y[0], m_positions.z[0], 1.0f);
+        vec_t<float> max = min;
 
-        //m_triangles[i].c1 = color_t(col[base_index_1 + 0], col[base_index_1 + 1], col[base_index_1 + 2]);
-        //m_triangles[i].c2 = color_t(col[base_index_2 + 0], col[base_index_2 + 1], col[base_index_2 + 2]);
-        //m_triangles[i].c3 = color_t(col[base_index_3 + 0], col[base_index_3 + 1], col[base_index_3 + 2]);
+        for (unsigned int i = 1; i < num_vertices; ++i) {
+            min.set(std::min(min[0], m_positions.x[i]), std::min(min[1], m_positions.y[i]), std::min(min[2], m_positions.z[i]));
+            max.set(std::max(max[0], m_positions.x[i]), std::max(max[1], m_positions.y[i]), std::max(max[2], m_positions.z[i]));
+        }
 
-        tex_index_1 = (2 * (3 * i + 0)) % tex.size();
-        tex_index_2 = (2 * (3 * i + 1)) % tex.size();
-        tex_index_3 = (2 * (3 * i + 2)) % tex.size();
+        // the sphere is centered on the box, which is tight enough for our meshes
+        const vec_t<float> center = 0.5f * (min + max);
 
-        m_triangles[i].v1.u = tex[tex_index_1 + 0];
-        m_triangles[i].v1.v = tex[tex_index_1 + 1];
+        float radius = 0.0f;
+        for (unsigned int i = 0; i < num_vertices; ++i) {
+            const vec_t<float> d(m_positions.x[i] - center[0], m_positions.y[i] - center[1], m_positions.z[i] - center[2], 0.0f);
+            radius = std::max(radius, d.dot(d));
+        }
 
-        m_triangles[i].v2.u = tex[tex_index_2 + 0];
-        m_triangles[i].v2.v = tex[tex_index_2 + 1];
+        m_bounding_box = aabb_t(min, max);
+        m_bounding_sphere = sphere_t(vec_t<float>(center[0], center[1], center[2], 1.0f), std::sqrt(radius));
+    }
 
-        m_triangles[i].v3.u = tex[tex_index_3 + 0];
-        m_triangles[i].v3.v = tex[tex_index_3 + 1];
+    // without groups the whole mesh is a single group
+    if (groups.empty()) {
+        groups.push_back(num_edges);
     }
+
+    unsigned int first_index = 0;
+    for (unsigned int size : groups) {
+        if (first_index + 3 * size > num_indices) {
+            throw std::runtime_error("groups exceed the number of triangles");
+        }
+
+        group_t group;
+        group.first_index = first_index;
+        group.num_indices = 3 * size;
+        group.first_vertex = 0;
+        group.num_vertices = 0;
+
+        // vertices are stored in order of first use, so the vertices of a group
+        // usually form a tight span
+        if (size > 0) {
+            unsigned int min_vertex = m_indices[first_index], max_vertex = min_vertex;
+            vec_t<float> min(m_positions.x[min_vertex], m_positions.y[min_vertex], m_positions.z[min_vertex], 1.0f);
+            vec_t<float> max = min;
+
+            for (unsigned int i = first_index; i < first_index + group.num_indices; ++i) {
+                const unsigned int index = m_indices[i];
+                min_vertex = std::min(min_vertex, index);
+                max_vertex = std::max(max_vertex, index);
+
+                min.set(std::min(min[0], m_positions.x[index]), std::min(min[1], m_positions.y[index]), std::min(min[2], m_positions.z[index]));
+                max.set(std::max(max[0], m_positions.x[index]), std::max(max[1], m_positions.y[index]), std::max(max[2], m_positions.z[index]));
+            }
+
+            group.first_vertex = min_vertex;
+            group.num_vertices = max_vertex - min_vertex + 1;
+            group.bounds = aabb_t(min, max);
+        }
+
+        m_groups.push_back(group);
+        first_index += group.num_indices;
+    }
+
+    m_clip_positions.resize(m_positions.size());
+    m_screen_positions.resize(m_positions.size());
+    m_outcodes.resize(m_positions.size());
 }
 
-inline void Model::sample_texture(float u, float v, color_t & out_color) {
-    const int tex_width = m_texture.get_width();
-    const int tex_height = m_texture.get_height();
-    const std::vector<uint8_t>& tex_buffer = m_texture.get_buffer();
+const pipeline_stats_t& Model::get_stats() const {
+    return m_stats;
+}
 
-    int x = ((int)(u * tex_width)) % tex_width;
-    int y = ((int)(v * tex_height)) % tex_height;
-    int index = 4 * (y * tex_width + x);
+const aabb_t& Model::get_bounding_box() const {
+    return m_bounding_box;
+}
 
-    out_color.r = tex_buffer[index + 0];
-    out_color.g = tex_buffer[index + 1];
-    out_color.b = tex_buffer[index + 2];
+const sphere_t& Model::get_bounding_sphere() const {
+    return m_bounding_sphere;
+}
+
+unsigned int Model::get_num_groups() const {
+    return m_groups.size();
+}
+
+const aabb_t& Model::get_group_bounds(unsigned int group) const {
+    return m_groups[group].bounds;
 }
 
 inline float Model::edge_function(const vec_t<float>& a, const vec_t<float>& b, const vec_t<float>& c) {
     return (c[0] - a[0]) * (b[1] - a[1]) - (c[1] - a[1]) * (b[0] - a[0]);
 }
 
-inline float Model::edge_function(const vec_t<float>& a, const vec_t<float>& b, int cx, int cy) {
-    return (cx - a[0] + 0.5f) * (b[1] - a[1]) - (cy - a[1] + 0.5f) * (b[0] - a[0]);
+inline vertex_t Model::clip_vertex(unsigned int index) {
+    return vertex_t(vec_t<float>(m_clip_positions.x[index], m_clip_positions.y[index], m_clip_positions.z[index], m_clip_positions.w[index]), m_tex_u[index], m_tex_v[index]);
 }
 
-inline float Model::signed_distance(const vec_t<float>& normal, float d, const vec_t<float>& point) {
-    return normal.dot(point) - d;
+inline vertex_t Model::screen_vertex(unsigned int index) {
+    return vertex_t(vec_t<float>(m_screen_positions.x[index], m_screen_positions.y[index], m_screen_positions.z[index], 1.0f), m_tex_u[index], m_tex_v[index]);
 }
 
-inline float Model::intersect(const vec_t<float>& v1, const vec_t<float>& v2, const vec_t<float>& normal, float d) {
-    return (d - normal.dot(v1)) / normal.dot(v2 - v1);
+// signed distance of a clip space point to one of the clipping planes, positive inside
+inline float Model::plane_distance(unsigned int plane, const vec_t<float>& p, float width, float height) {
+    switch (plane) {
+        case clip_near:         return p[3] - 1.0f;
+        case clip_guard_left:   return p[0] + guard_band * p[3];
+        case clip_guard_right:  return (width + guard_band) * p[3] - p[0];
+        case clip_guard_top:    return p[1] + guard_band * p[3];
+        default:                return (height + guard_band) * p[3] - p[1];
+    }
 }
 
-inline void Model::clip_triangle(const vec_t<float>& normal, float d, vertex_t& v1, vertex_t& v2, vertex_t& v3) {
-    float t2 = intersect(v1.pos, v2.pos, normal, d);
-    float t3 = intersect(v1.pos, v3.pos, normal, d);
+// clips a convex polygon against a single plane (Sutherland-Hodgman), returns the new vertex count
+inline unsigned int Model::clip_polygon(unsigned int plane, const vertex_t * in, unsigned int count, vertex_t * out, float width, float height) {
+    unsigned int out_count = 0;
+
+    float d0 = plane_distance(plane, in[count - 1].pos, width, height);
+    for (unsigned int i = 0, j = count - 1; i < count; j = i++) {
+        const float d1 = plane_distance(plane, in[i].pos, width, height);
+
+        if ((d0 > 0) != (d1 > 0)) {
+            const vertex_t& a = in[j];
+            const vertex_t& b = in[i];
+            const float t = d0 / (d0 - d1);
+
+            // scaling a vec_t leaves w alone, but in clip space it has to be interpolated too
+            vec_t<float> pos = a.pos + t * (b.pos - a.pos);
+            pos[3] = a.pos[3] + t * (b.pos[3] - a.pos[3]);
+
+            out[out_count++] = vertex_t(pos, a.u + t * (b.u - a.u), a.v + t * (b.v - a.v));
+        }
 
-    // interpolate coordinates for texture
-    v2.u = t2 * v2.u + (1 - t2) * v1.u;
-    v2.v = t2 * v2.v + (1 - t2) * v1.v;
+        if (d1 > 0) {
+            out[out_count++] = in[i];
+        }
 
-    v3.u = t3 * v3.u + (1 - t3) * v1.u;
-    v3.v = t3 * v3.v + (1 - t3) * v1.v;
+        d0 = d1;
+    }
 
-    v2.pos = v1.pos + t2 * (v2.pos - v1.pos);
-    v3.pos = v1.pos + t3 * (v3.pos - v1.pos);
+    return out_count;
 }
 
-inline void Model::clip_triangle(const vec_t<float>& normal, float d, vertex_t& v1, vertex_t& v2, vertex_t& v3, triangle_t& out_t1, triangle_t& out_t2) {
-    float t1 = intersect(v1.pos, v3.pos, normal, d);
-    float t2 = intersect(v2.pos, v3.pos, normal, d);
+void Model::render(GraphicsContext& context, const mat_t<float>& projection, const mat_t<float>& world_view) {
+    const float width = context.get_width();
+    const float height = context.get_height();
 
-    //vec_t<float> v2_p = v2.pos + t2 * (v3.pos - v2.pos);
+    begin_draw(context);
 
-    vertex_t v1_p(
-        v1.pos + t1 * (v3.pos - v1.pos), 
-        t1 * v3.u + (1 - t1) * v1.u, 
-        t1 * v3.v + (1 - t1) * v1.v
-    );
+    // transform every unique vertex once straight into clip space
+    transform_vertices(projection * world_view, 0, m_positions.size(), width, height);
+    draw_triangles(context, 0, m_indices.size());
 
-    vertex_t v2_p(
-        v2.pos + t2 * (v3.pos - v2.pos), 
-        t2 * v3.u + (1 - t2) * v2.u, 
-        t2 * v3.v + (1 - t2) * v2.v
-    );
+    end_draw(context);
+}
 
-    out_t1.v1 = v1;
-    out_t1.v2 = v2_p;
-    out_t1.v3 = v1_p;
+void Model::render(GraphicsContext& context, const mat_t<float>& projection, const mat_t<float>& world_view, const std::vector<unsigned int>& groups) {
+    const float width = context.get_width();
+    const float height = context.get_height();
+    const mat_t<float> clip = projection * world_view;
 
-    out_t2.v1 = v1;
-    out_t2.v2 = v2;
-    out_t2.v3 = v2_p;
+    begin_draw(context);
+
+    // only the vertices referenced by the drawn groups are transformed
+    for (unsigned int index : groups) {
+        const group_t& group = m_groups[index];
+        if (group.num_indices == 0) {
+            continue;
+        }
+
+        transform_vertices(clip, group.first_vertex, group.num_vertices, width, height);
+        draw_triangles(context, group.first_index, group.num_indices);
+    }
+
+    end_draw(context);
 }
 
+void Model::begin_draw(GraphicsContext& context) {
+    // the counters of a frame start over with its first draw
+    if (m_stats_frame != context.get_frame_number()) {
+        m_stats_frame = context.get_frame_number();
+        m_stats = pipeline_stats_t();
+    }
 
-void Model::render(GraphicsContext& context, const mat_t<float>& projection, const mat_t<float>& world_view) {
-    // clipping plane (const)
-    static const vec_t<float> clip_normal(0.0f, 0.0f, 1.0f);
-    static const float clip_d = 1.0f;
-
-    const color_t color(255, 255, 255);
-
-    triangle_t t1, t2;
-    for (const triangle_t& triangle : m_triangles) {
-        triangle_t wv_triangle = triangle;
-
-        wv_triangle.v1.pos = world_view * wv_triangle.v1.pos;
-        wv_triangle.v2.pos = world_view * wv_triangle.v2.pos;
-        wv_triangle.v3.pos = world_view * wv_triangle.v3.pos;
-
-        float d1 = signed_distance(clip_normal, clip_d, wv_triangle.v1.pos);
-        float d2 = signed_distance(clip_normal, clip_d, wv_triangle.v2.pos);
-        float d3 = signed_distance(clip_normal, clip_d, wv_triangle.v3.pos);
-
-        bool wireframe = context.is_wireframe();
-        
-        const int condition = ((d3 > 0) << 2) | ((d2 > 0) << 1) | (d1 > 0);
-        switch (condition) {
-            case 0b000: // (VIII)
-                break;
-
-            case 0b011: // (II)
-                clip_triangle(clip_normal, clip_d, wv_triangle.v1, wv_triangle.v2, wv_triangle.v3, t1, t2);
-                fill_triangle(context, t1, projection, wireframe);
-                fill_triangle(context, t2, projection, wireframe);
-                break;
-
-            case 0b101: // (III)
-                clip_triangle(clip_normal, clip_d, wv_triangle.v3, wv_triangle.v1, wv_triangle.v2, t1, t2);
-                fill_triangle(context, t1, projection, wireframe);
-                fill_triangle(context, t2, projection, wireframe);
-                break;
-
-            case 0b110: // (I)
-                clip_triangle(clip_normal, clip_d, wv_triangle.v2, wv_triangle.v3, wv_triangle.v1, t1, t2);
-                fill_triangle(context, t1, projection, wireframe);
-                fill_triangle(context, t2, projection, wireframe);
-                break;
-
-            case 0b001: // (VI)
-                clip_triangle(clip_normal, clip_d, wv_triangle.v1, wv_triangle.v2, wv_triangle.v3);
-                fill_triangle(context, wv_triangle, projection, wireframe);
-                break;
-
-            case 0b010: // (V)
-                clip_triangle(clip_normal, clip_d, wv_triangle.v2, wv_triangle.v3, wv_triangle.v1);
-                fill_triangle(context, wv_triangle, projection, wireframe);
-                break;
-
-            case 0b100: // (IV)
-                clip_triangle(clip_normal, clip_d, wv_triangle.v3, wv_triangle.v1, wv_triangle.v2);
-                fill_triangle(context, wv_triangle, projection, wireframe);
-                break;
-
-            case 0b111: // 111 (VII)
-                fill_triangle(context, wv_triangle, projection, wireframe);
-                break;
+    m_draw_stats = pipeline_stats_t();
+}
+
+void Model::end_draw(GraphicsContext& context) {
+    m_stats += m_draw_stats;
+    context.add_stats(m_draw_stats);
+}
+
+void Model::transform_vertices(const mat_t<float>& clip, unsigned int first_vertex, unsigned int num_vertices, float width, float height) {
+    transform_points(clip, m_positions, m_clip_positions, first_vertex, num_vertices);
+
+    // classify every vertex against the frustum and the guard band, vertices in
+    // front of the near plane are divided right away so triangles that need no
+    // clipping can reuse them
+    for (unsigned int i = first_vertex; i < first_vertex + num_vertices; ++i) {
+        const float x = m_clip_positions.x[i];
+        const float y = m_clip_positions.y[i];
+        const float w = m_clip_positions.w[i];
+
+        unsigned int outcode = 0;
+        outcode |= (w <= 1.0f) ? clip_near : 0;
+        outcode |= (x < 0.0f) ? clip_left : 0;
+        outcode |= (x > width * w) ? clip_right : 0;
+        outcode |= (y < 0.0f) ? clip_top : 0;
+        outcode |= (y > height * w) ? clip_bottom : 0;
+        outcode |= (x < -guard_band * w) ? clip_guard_left : 0;
+        outcode |= (x > (width + guard_band) * w) ? clip_guard_right : 0;
+        outcode |= (y < -guard_band * w) ? clip_guard_top : 0;
+        outcode |= (y > (height + guard_band) * w) ? clip_guard_bottom : 0;
+        m_outcodes[i] = outcode;
+
+        if (!(outcode & clip_near)) {
+            m_screen_positions.x[i] = x / w;
+            m_screen_positions.y[i] = y / w;
+            m_screen_positions.z[i] = m_clip_positions.z[i] / w;
         }
     }
 }
 
-void Model::fill_triangle(GraphicsContext& context, triangle_t& triangle, const mat_t<float>& projection, bool wireframe) {  
-    int width = context.get_width();
-    int height = context.get_height();
+void Model::draw_triangles(GraphicsContext& context, unsigned int first_index, unsigned int num_indices) {
+    const float width = context.get_width();
+    const float height = context.get_height();
+
+    bool wireframe = context.is_wireframe();
+
+    // a triangle clipped by up to 5 planes has at most 8 vertices
+    vertex_t polygon[2][8];
+
+    m_draw_stats.triangles_submitted += num_indices / 3;
+
+    for (unsigned int i = first_index; i < first_index + num_indices; i += 3) {
+        const unsigned int i1 = m_indices[i + 0];
+        const unsigned int i2 = m_indices[i + 1];
+        const unsigned int i3 = m_indices[i + 2];
+
+        const unsigned int oc1 = m_outcodes[i1], oc2 = m_outcodes[i2], oc3 = m_outcodes[i3];
+
+        // all vertices outside the same plane
+        if (oc1 & oc2 & oc3) {
+            m_draw_stats.triangles_rejected++;
+            continue;
+        }
+
+        // inside the guard band, the rasterizer clamps to the viewport
+        const unsigned int planes = (oc1 | oc2 | oc3) & clip_mask;
+        if (!planes) {
+            fill_triangle(context, triangle_t(screen_vertex(i1), screen_vertex(i2), screen_vertex(i3)), wireframe);
+            continue;
+        }
 
-    triangle.v1.pos = projection * triangle.v1.pos;
-    triangle.v2.pos = projection * triangle.v2.pos;
-    triangle.v3.pos = projection * triangle.v3.pos;
+        polygon[0][0] = clip_vertex(i1);
+        polygon[0][1] = clip_vertex(i2);
+        polygon[0][2] = clip_vertex(i3);
 
-    triangle.v1.pos.perspective_divide();
-    triangle.v2.pos.perspective_divide();
-    triangle.v3.pos.perspective_divide();
+        unsigned int count = 3, current = 0;
+        for (unsigned int plane = clip_near; (plane & clip_mask) && count >= 3; plane <<= 1) {
+            if (planes & plane) {
+                count = clip_polygon(plane, polygon[current], count, polygon[current ^ 1], width, height);
+                current ^= 1;
+            }
+        }
+
+        switch (count) {
+            case 0: case 1: case 2: m_draw_stats.clipped_away++; break;
+            case 3: m_draw_stats.clipped_to_one++; break;
+            case 4: m_draw_stats.clipped_to_two++; break;
+            default: m_draw_stats.clipped_to_more++; break;
+        }
+
+        for (unsigned int k = 0; k < count; ++k) {
+            polygon[current][k].pos.perspective_divide();
+        }
+
+        for (unsigned int k = 1; k + 1 < count; ++k) {
+            fill_triangle(context, triangle_t(polygon[current][0], polygon[current][k], polygon[current][k + 1]), wireframe);
+        }
+    }
+}
+
+void Model::fill_triangle(GraphicsContext& context, const triangle_t& triangle, bool wireframe) {
+    int width = context.get_width();
+    int height = context.get_height();
 
     // area of the triangle, used in baricentric coordinates
     float area = edge_function(triangle.v1.pos, triangle.v2.pos, triangle.v3.pos);
     if (area < 0) { // backface culling
+        m_draw_stats.triangles_backface++;
         return;
     }
 
@@ -218,48 +354,10 @@ void Model::fill_triangle(GraphicsContext& context, triangle_t& triangle, const
     max_x = std::min(width, max_x + 1);
 
     if (!wireframe) {
-        fill_scanlines(context, triangle, area, min_x, max_x, min_y, max_y, 1);
+        context.draw_triangle(raster_triangle_t(triangle, area, min_x, max_x, min_y, max_y, m_texture.get()));
     } else {
         context.draw_line(triangle.v1.pos[0], triangle.v1.pos[1], triangle.v2.pos[0], triangle.v2.pos[1], color_t(0, 255, 0));
         context.draw_line(triangle.v2.pos[0], triangle.v2.pos[1], triangle.v3.pos[0], triangle.v3.pos[1], color_t(0, 255, 0));
         context.draw_line(triangle.v3.pos[0], triangle.v3.pos[1], triangle.v1.pos[0], triangle.v1.pos[1], color_t(0, 255, 0));
     }
 }
-
-void Model::fill_scanlines(GraphicsContext& context, const triangle_t& triangle, const float area, const int min_x, const int max_x, const int min_y, const int max_y, const int step) {
-    for (int y = min_y; y < max_y; y = y + step) {
-        for (int x = min_x; x < max_x; ++x) {
-            color_t color;
-
-            float w1 = edge_function(triangle.v2.pos, triangle.v3.pos, x, y);
-            float w2 = edge_function(triangle.v3.pos, triangle.v1.pos, x, y);
-            float w3 = edge_function(triangle.v1.pos, triangle.v2.pos, x, y);
-
-            if (w1 >= 0.0f && w2 >= 0.0f && w3 >= 0.0f) {
-                w1 = w1 / area;
-                w2 = w2 / area;
-                w3 = w3 / area;
-
-                float depth = 1.0f / (w1 * triangle.v1.pos[2] + w2 * triangle.v2.pos[2] + w3 * triangle.v3.pos[2]);
-                
-                if (context.set_depth(x, y, depth)) {
-                    // perspective corrected interpolation
-                    float u = depth * (
-                        w1 * triangle.v1.u * triangle.v1.pos[2] + 
-                        w2 * triangle.v2.u * triangle.v2.pos[2] + 
-                        w3 * triangle.v3.u * triangle.v3.pos[2]
-                    );
-
-                    float v = depth * (
-                        w1 * triangle.v1.v * triangle.v1.pos[2] + 
-                        w2 * triangle.v2.v * triangle.v2.pos[2] + 
-                        w3 * triangle.v3.v * triangle.v3.pos[2]
-                    );
-
-                    sample_texture(u, v, color);
-                    context.set_pixel(x, y, color);
-                }
-            }
-        }
-    }
-}
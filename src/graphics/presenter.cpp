@@ -0,0 +1,329 @@
+#include <stdexcept>
+#include <exception>
+#include <string>
+#include <cstdio>
+
+#include "graphics/presenter.hpp"
+
+bool Presenter::is_zero_copy() {
+    return m_zero_copy;
+}
+
+void Presenter::set_zero_copy(bool value) {
+    m_zero_copy = value;
+}
+
+Presenter::Presenter(SDL_Window * window, GraphicsContext& context) : m_context(context) {
+    m_window = window;
+
+    m_width = context.get_width();
+    m_height = context.get_height();
+
+    for (frame_t& frame : m_frame_buffers) {
+        frame.buffer.resize(m_width * m_height);
+    }
+
+    m_last_frame = std::chrono::steady_clock::now();
+    m_frameTimer = 0;
+    m_frames = 0;
+    m_fpsAvg = 0;
+    m_zero_copy = false;
+
+    m_font = TTF_OpenFont("assets/font.ttf", 32);
+    if (!m_font) {
+        throw std::runtime_error("failed to initialize font");
+    }
+
+    // every sdl render call is made on this thread, from here and from show()
+    m_renderer = SDL_CreateRenderer(m_window, -1, SDL_RENDERER_ACCELERATED);
+
+    if (!m_renderer) {
+        TTF_CloseFont(m_font);
+        throw std::runtime_error("failed to initialize renderer: " + std::string(SDL_GetError()));
+    }
+
+    try {
+        build_glyph_atlas();
+
+        for (unsigned int i = 0; i < num_frames; ++i) {
+            m_frame_buffers[i].texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888,
+                SDL_TEXTUREACCESS_STREAMING, m_width, m_height);
+
+            if (!m_frame_buffers[i].texture) {
+                throw std::runtime_error("failed to create frame texture: " + std::string(SDL_GetError()));
+            }
+
+            prepare_frame(m_frame_buffers[i]);
+            m_free_frames.push_back(i);
+        }
+    } catch (const std::exception&) {
+        destroy_textures();
+        SDL_DestroyRenderer(m_renderer);
+        TTF_CloseFont(m_font);
+        throw;
+    }
+
+    acquire_frame();
+}
+
+Presenter::~Presenter() {
+    // the context must not keep drawing into a frame that is about to go away,
+    // frames still queued are dropped
+    m_context.set_color_buffer(nullptr, 0);
+
+    destroy_textures();
+    SDL_DestroyRenderer(m_renderer);
+
+    if (m_font) {
+        TTF_CloseFont(m_font);
+    }
+}
+
+void Presenter::present() {
+    m_context.finish();
+
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_last_frame).count();
+
+    m_last_frame = now;
+    m_frameTimer += elapsed;
+
+    if (m_frameTimer > 1000) {
+        m_fpsAvg = m_frames;
+        m_frames = 0;
+        m_frameTimer = m_frameTimer - 1000;
+    }
+
+    // the frame is finished, show() uploads and puts it on the window while the next
+    // one is drawn. the old contents of a frame are undefined, but the context has
+    // either drawn or cleared every pixel by the time it is finished
+    render_text(30, 30, std::string("fps: " + std::to_string(m_fpsAvg)).c_str());
+
+    // where the frame went, overdraw is the number of depth writes per pixel
+    const pipeline_stats_t& stats = m_context.get_stats();
+    const uint64_t clipped = stats.clipped_away + stats.clipped_to_one + stats.clipped_to_two + stats.clipped_to_more;
+    char text[256];
+
+    std::snprintf(text, sizeof(text),
+        "tris %llu rej %llu clip %llu back %llu drawn %llu\n"
+        "px %llu pass %llu fail %llu tex %llu\n"
+        "hiz %llu overdraw %.2f",
+        (unsigned long long)stats.triangles_submitted, (unsigned long long)stats.triangles_rejected,
+        (unsigned long long)clipped, (unsigned long long)stats.triangles_backface,
+        (unsigned long long)stats.triangles_rasterized, (unsigned long long)stats.pixels_tested,
+        (unsigned long long)stats.depth_passed, (unsigned long long)stats.depth_failed,
+        (unsigned long long)stats.texture_samples, (unsigned long long)stats.blocks_hiz_culled,
+        (double)stats.depth_passed / (m_width * m_height));
+
+    render_text(30, 70, text);
+
+    {
+        std::lock_guard<std::mutex> lock(m_present_mutex);
+
+        // nothing shows frames any more, keep drawing into this one
+        if (m_present_stop) {
+            return;
+        }
+
+        m_queued_frames.push_back(m_current_frame);
+    }
+
+    m_present_cv.notify_all();
+    acquire_frame();
+
+    m_frames = m_frames + 1;
+}
+
+void Presenter::acquire_frame() {
+    std::unique_lock<std::mutex> lock(m_present_mutex);
+    m_present_cv.wait(lock, [this] { return m_present_stop || !m_free_frames.empty(); });
+
+    // closed while waiting, the context draws into the frame it already has
+    if (m_free_frames.empty()) {
+        return;
+    }
+
+    m_current_frame = m_free_frames.front();
+    m_free_frames.pop_front();
+    lock.unlock();
+
+    frame_t& frame = m_frame_buffers[m_current_frame];
+    frame.texts.clear();
+    frame.chars.clear();
+
+    m_context.set_color_buffer(frame.pixels, frame.pitch);
+}
+
+bool Presenter::show() {
+    std::unique_lock<std::mutex> lock(m_present_mutex);
+    m_present_cv.wait(lock, [this] { return m_present_stop || !m_queued_frames.empty(); });
+
+    if (m_queued_frames.empty()) {
+        return false;
+    }
+
+    const unsigned int index = m_queued_frames.front();
+    m_queued_frames.pop_front();
+    lock.unlock();
+
+    // a locked texture already holds the frame
+    frame_t& frame = m_frame_buffers[index];
+
+    if (frame.locked) {
+        SDL_UnlockTexture(frame.texture);
+        frame.locked = false;
+    } else {
+        SDL_UpdateTexture(frame.texture, nullptr, frame.buffer.data(), m_width * sizeof(uint32_t));
+    }
+
+    SDL_RenderCopy(m_renderer, frame.texture, nullptr, nullptr);
+
+    for (const text_t& text : frame.texts) {
+        draw_text(frame, text);
+    }
+
+    SDL_RenderPresent(m_renderer);
+    prepare_frame(frame);
+
+    lock.lock();
+    m_free_frames.push_back(index);
+    lock.unlock();
+
+    m_present_cv.notify_all();
+    return true;
+}
+
+void Presenter::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_present_mutex);
+        m_present_stop = true;
+    }
+
+    m_present_cv.notify_all();
+}
+
+void Presenter::destroy_textures() {
+    // also called when setup failed halfway, anything not created yet is null
+    for (frame_t& frame : m_frame_buffers) {
+        if (!frame.texture) {
+            continue;
+        }
+
+        if (frame.locked) {
+            SDL_UnlockTexture(frame.texture);
+            frame.locked = false;
+        }
+
+        SDL_DestroyTexture(frame.texture);
+        frame.texture = nullptr;
+    }
+
+    if (m_glyph_atlas) {
+        SDL_DestroyTexture(m_glyph_atlas);
+        m_glyph_atlas = nullptr;
+    }
+}
+
+void Presenter::prepare_frame(frame_t& frame) {
+    void * pixels;
+    int pitch;
+
+    if (m_zero_copy && SDL_LockTexture(frame.texture, nullptr, &pixels, &pitch) == 0) {
+        frame.pixels = static_cast<uint32_t*>(pixels);
+        frame.pitch = pitch / sizeof(uint32_t);
+        frame.locked = true;
+        return;
+    }
+
+    frame.pixels = frame.buffer.data();
+    frame.pitch = m_width;
+}
+
+void Presenter::render_text(int x, int y, const char * text) {
+    frame_t& frame = m_frame_buffers[m_current_frame];
+    const unsigned int first = frame.chars.size();
+
+    frame.chars.append(text);
+    frame.texts.push_back({ x, y, first, (unsigned int)(frame.chars.size() - first) });
+}
+
+void Presenter::build_glyph_atlas() {
+    const unsigned int num_glyphs = last_glyph - first_glyph + 1;
+    SDL_Surface * glyphs[num_glyphs];
+    int width = 0, height = 0;
+
+    // the glyphs rendered so far are freed when building the atlas fails
+    auto free_glyphs = [&glyphs](unsigned int count) {
+        for (unsigned int i = 0; i < count; ++i) {
+            SDL_FreeSurface(glyphs[i]);
+        }
+    };
+
+    // every glyph is rendered on its own, so text drawn from the atlas has no kerning
+    for (unsigned int i = 0; i < num_glyphs; ++i) {
+        const char text[2] = { (char)(first_glyph + i), '\0' };
+        glyphs[i] = TTF_RenderText_Solid(m_font, text, {255, 255, 255, SDL_ALPHA_OPAQUE});
+
+        if (!glyphs[i]) {
+            free_glyphs(i);
+            throw std::runtime_error("failed to render glyph: " + std::string(TTF_GetError()));
+        }
+
+        width += glyphs[i]->w;
+        height = std::max(height, glyphs[i]->h);
+    }
+
+    SDL_Surface * atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+
+    if (!atlas) {
+        free_glyphs(num_glyphs);
+        throw std::runtime_error("failed to create glyph atlas: " + std::string(SDL_GetError()));
+    }
+
+    // transparent everywhere but the glyphs
+    SDL_FillRect(atlas, nullptr, 0);
+
+    for (unsigned int i = 0, x = 0; i < num_glyphs; x += glyphs[i]->w, ++i) {
+        m_glyph_rects[i] = { (int)x, 0, glyphs[i]->w, glyphs[i]->h };
+
+        SDL_Rect rect = m_glyph_rects[i];
+        SDL_BlitSurface(glyphs[i], nullptr, atlas, &rect);
+    }
+
+    free_glyphs(num_glyphs);
+
+    m_glyph_atlas = SDL_CreateTextureFromSurface(m_renderer, atlas);
+    m_glyph_height = height;
+    SDL_FreeSurface(atlas);
+
+    if (!m_glyph_atlas) {
+        throw std::runtime_error("failed to create glyph atlas: " + std::string(SDL_GetError()));
+    }
+
+    SDL_SetTextureBlendMode(m_glyph_atlas, SDL_BLENDMODE_BLEND);
+}
+
+void Presenter::draw_text(const frame_t& frame, const text_t& text) {
+    SDL_Rect rect = { text.x, text.y, 0, 0 };
+
+    for (unsigned int i = 0; i < text.length; ++i) {
+        char c = frame.chars[text.first + i];
+
+        if (c == '\n') {
+            rect.x = text.x;
+            rect.y += m_glyph_height;
+            continue;
+        }
+
+        if (c < first_glyph || c > last_glyph) {
+            c = '?';
+        }
+
+        const SDL_Rect& glyph = m_glyph_rects[c - first_glyph];
+        rect.w = glyph.w;
+        rect.h = glyph.h;
+
+        SDL_RenderCopy(m_renderer, m_glyph_atlas, &glyph, &rect);
+        rect.x += glyph.w;
+    }
+}
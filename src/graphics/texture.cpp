@@ -2,6 +2,9 @@
 
 #include <stdexcept>
 #include <exception>
+#include <unordered_map>
+#include <mutex>
+#include <iterator>
 
 unsigned int Texture::get_width() const {
 	return m_width;
@@ -19,9 +22,48 @@ std::vector<uint8_t> & Texture::get_buffer() {
 	return m_buffer;
 }
 
+const uint32_t * Texture::get_texels() const {
+	return m_texels.data();
+}
+
+const Texture::levels_t & Texture::get_levels() const {
+	return m_levels;
+}
+
+unsigned int Texture::get_num_levels() const {
+	return m_num_levels;
+}
+
+std::shared_ptr<const Texture> Texture::load(const std::string & filename) {
+	// the cache only holds weak references, the models using a texture own it
+	static std::unordered_map<std::string, std::weak_ptr<const Texture>> cache;
+	static std::mutex cache_mutex;
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto it = cache.find(filename);
+	if (it != cache.end()) {
+		if (std::shared_ptr<const Texture> texture = it->second.lock()) {
+			return texture;
+		}
+	}
+
+	// drop the textures nobody uses any more before adding one, so the cache
+	// does not grow with every file that was ever loaded
+	for (auto entry = cache.begin(); entry != cache.end();) {
+		entry = entry->second.expired() ? cache.erase(entry) : std::next(entry);
+	}
+
+	std::shared_ptr<const Texture> texture = std::make_shared<const Texture>(filename);
+	cache[filename] = texture;
+
+	return texture;
+}
+
 Texture::Texture() {
 	m_buffer = { 255, 255, 255, 255 };
 	m_width = m_height = 1;
+
+	build_texels();
 }
 
 Texture::Texture(const std::string & filename) {
@@ -63,4 +105,81 @@ Texture::Texture(const std::string & filename) {
 
 	SDL_UnlockSurface(loaded_surface);
 	SDL_FreeSurface(loaded_surface);
+
+	build_texels();
+}
+
+void Texture::build_texels() {
+	unsigned int width = 4, height = 4, tiles_shift = 0;
+
+	while (width < m_width) {
+		width <<= 1;
+		tiles_shift++;
+	}
+
+	while (height < m_height) {
+		height <<= 1;
+	}
+
+	m_texels.resize(width * height);
+
+	// nearest neighbor resampling, a no-op for power of two images
+	for (unsigned int y = 0; y < height; ++y) {
+		const unsigned int src_y = y * m_height / height;
+
+		for (unsigned int x = 0; x < width; ++x) {
+			const unsigned int src_x = x * m_width / width;
+
+			// packed as ARGB8888 like the framebuffer so shading is a plain copy,
+			// nothing is blended so the alpha is always opaque
+			const uint8_t * texel = &m_buffer[4 * (src_y * m_width + src_x)];
+			m_texels[get_texel_index(x, y, tiles_shift)] = 0xff000000u | (uint32_t(texel[0]) << 16) | (uint32_t(texel[1]) << 8) | uint32_t(texel[2]);
+		}
+	}
+
+	m_levels.offset[0] = 0;
+	m_levels.width[0] = width;
+	m_levels.height[0] = height;
+	m_levels.tiles_shift[0] = tiles_shift;
+	m_num_levels = 1;
+
+	while (m_num_levels < max_levels && m_levels.width[m_num_levels - 1] > 4 && m_levels.height[m_num_levels - 1] > 4) {
+		build_mip_level();
+	}
+}
+
+void Texture::build_mip_level() {
+	const unsigned int src_level = m_num_levels - 1;
+	const unsigned int src_shift = m_levels.tiles_shift[src_level];
+
+	const unsigned int width = m_levels.width[src_level] / 2;
+	const unsigned int height = m_levels.height[src_level] / 2;
+	const unsigned int tiles_shift = src_shift - 1;
+	const unsigned int offset = m_texels.size();
+
+	m_texels.resize(offset + width * height);
+
+	const uint8_t * src = reinterpret_cast<const uint8_t*>(m_texels.data() + m_levels.offset[src_level]);
+	uint8_t * dst = reinterpret_cast<uint8_t*>(m_texels.data() + offset);
+
+	// 2x2 box filter, every channel separately
+	for (unsigned int y = 0; y < height; ++y) {
+		for (unsigned int x = 0; x < width; ++x) {
+			const unsigned int i1 = 4 * get_texel_index(2 * x + 0, 2 * y + 0, src_shift);
+			const unsigned int i2 = 4 * get_texel_index(2 * x + 1, 2 * y + 0, src_shift);
+			const unsigned int i3 = 4 * get_texel_index(2 * x + 0, 2 * y + 1, src_shift);
+			const unsigned int i4 = 4 * get_texel_index(2 * x + 1, 2 * y + 1, src_shift);
+			const unsigned int out = 4 * get_texel_index(x, y, tiles_shift);
+
+			for (unsigned int c = 0; c < 4; ++c) {
+				dst[out + c] = (src[i1 + c] + src[i2 + c] + src[i3 + c] + src[i4 + c] + 2) / 4;
+			}
+		}
+	}
+
+	m_levels.offset[m_num_levels] = offset;
+	m_levels.width[m_num_levels] = width;
+	m_levels.height[m_num_levels] = height;
+	m_levels.tiles_shift[m_num_levels] = tiles_shift;
+	m_num_levels++;
 }
@@ -0,0 +1,82 @@
+#include "graphics/thread_pool.hpp"
+
+ThreadPool::ThreadPool(unsigned int num_threads) : m_next_job(0) {
+    m_threads.reserve(num_threads);
+
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        m_threads.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_start_cv.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned int ThreadPool::get_size() const {
+    return m_threads.size() + 1;
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& job) {
+    if (count == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_job_count = count;
+        m_next_job = 0;
+        m_active = m_threads.size();
+        m_generation = m_generation + 1;
+    }
+
+    m_start_cv.notify_all();
+
+    // the calling thread helps instead of sleeping
+    run_jobs();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_active == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::worker() {
+    unsigned int generation = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cv.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+
+            if (m_stop) {
+                return;
+            }
+
+            generation = m_generation;
+        }
+
+        run_jobs();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_active = m_active - 1;
+
+        if (m_active == 0) {
+            m_done_cv.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_jobs() {
+    for (std::size_t i = m_next_job++; i < m_job_count; i = m_next_job++) {
+        (*m_job)(i);
+    }
+}
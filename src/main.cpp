@@ -1,9 +1,14 @@
 #include <iostream>
+#include <fstream>
+#include <string>
 #include <cstdlib>
 #include <stdexcept>
 #include <exception>
 #include <vector>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
@@ -19,10 +24,12 @@
 #include "world/room.hpp"
 #include "world/player.hpp"
 
+#include "graphics/presenter.hpp"
+
 const unsigned int window_width = 1366;
 const unsigned int window_height = 768;
 
-void run(SDL_Window * window, Level * start_level);
+void run(SDL_Window * window, Level * start_level, const std::string& record_path);
 
 int main(int argc, char ** argv) {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -49,20 +56,34 @@ int main(int argc, char ** argv) {
         throw std::runtime_error("failed to create sdl2 window context: " + std::string(SDL_GetError()));
     }
 
-    Level * level = nullptr;
-    if (argc > 1) {
-        std::string level_name = std::string(argv[1]);
-
-        if (level_name == "maze") {
-            level = new Maze(15, 15);
+    // program [room|maze] [--seed n] [--record file], a recorded camera path
+    // can be replayed with bin/bench --path file
+    std::string level_name = "room";
+    std::string record_path;
+    std::string seed;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = std::string(argv[i]);
+
+        if (arg == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = argv[++i];
+        } else {
+            level_name = arg;
         }
     }
 
+    Level * level = nullptr;
+    if (level_name == "maze") {
+        level = seed.empty() ? new Maze(15, 15) : new Maze(15, 15, std::stoul(seed));
+    }
+
     if (!level) {
         level = new Room();
     }
 
-    run(window, level);
+    run(window, level, record_path);
 
     // cleanup
     SDL_DestroyWindow(window);
@@ -75,44 +96,112 @@ int main(int argc, char ** argv) {
     return 0;
 }
 
-void run(SDL_Window * window, Level * start_level) {
-    GraphicsContext * context = new GraphicsContext(window, window_width / 2, window_height / 2);
+void run(SDL_Window * window, Level * start_level, const std::string& record_path) {
+    GraphicsContext * context = new GraphicsContext(window_width / 2, window_height / 2);
+    Presenter * presenter = new Presenter(window, *context);
     Level * level = start_level;
 
     auto last_time = std::chrono::steady_clock::now();
     mat_t<float> projection_mat = perspective(window_width / 2, window_height / 2, PI_f / 3.0f);
 
-    bool running = true;
+    // one camera pose per frame
+    std::ofstream record;
+    if (!record_path.empty()) {
+        record.open(record_path);
 
-    while (running) {        
-        SDL_Event event;
+        if (!record) {
+            throw std::runtime_error("failed to open " + record_path + " for recording");
+        }
 
-        auto now = std::chrono::steady_clock::now();
-        float elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_time).count() / 1000.0f;
+        record.precision(9);
+    }
 
-        last_time = now;
+    // sdl wants events polled and its renderer used on the thread that created the window,
+    // so this thread only shows frames and hands the events to the thread drawing them
+    std::atomic<bool> running(true);
+    std::mutex event_mutex;
+    std::vector<SDL_Event> events;
 
-        level->update(elapsed);
+    std::thread draw_thread([&]() {
+        std::vector<SDL_Event> frame_events;
 
-        context->clear();
-        level->render(*context, projection_mat);
-        context->present();
+        while (running) {
+            {
+                std::lock_guard<std::mutex> lock(event_mutex);
+                frame_events.swap(events);
+            }
 
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                running = false;
-            } else {
+            for (const SDL_Event& event : frame_events) {
                 if (event.type == SDL_KEYUP) {
                     if (event.key.keysym.sym == SDL_KeyCode::SDLK_o) {
                         context->set_wireframe(!context->is_wireframe());
                     }
+
+                    if (event.key.keysym.sym == SDL_KeyCode::SDLK_t) {
+                        context->set_threaded(!context->is_threaded());
+                    }
+
+                    if (event.key.keysym.sym == SDL_KeyCode::SDLK_v) {
+                        context->set_visibility_buffer(!context->is_visibility_buffer());
+                    }
+
+                    if (event.key.keysym.sym == SDL_KeyCode::SDLK_p) {
+                        presenter->set_zero_copy(!presenter->is_zero_copy());
+                    }
+
+                    if (event.key.keysym.sym == SDL_KeyCode::SDLK_z) {
+                        switch (context->get_depth_format()) {
+                            case depth_format_t::float32: context->set_depth_format(depth_format_t::reversed_float32); break;
+                            case depth_format_t::reversed_float32: context->set_depth_format(depth_format_t::unorm16); break;
+                            case depth_format_t::unorm16: context->set_depth_format(depth_format_t::float32); break;
+                        }
+                    }
                 }
 
                 level->event(event);
             }
+
+            frame_events.clear();
+
+            auto now = std::chrono::steady_clock::now();
+            float elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_time).count() / 1000.0f;
+
+            last_time = now;
+
+            level->update(elapsed);
+
+            if (record.is_open()) {
+                const vec_t<float>& eye = level->get_camera_eye();
+                const vec_t<float>& at = level->get_camera_at();
+                record << eye[0] << " " << eye[1] << " " << eye[2] << " " << at[0] << " " << at[1] << " " << at[2] << "\n";
+            }
+
+            context->clear();
+            level->render(*context, projection_mat);
+            presenter->present();
+        }
+    });
+
+    while (running) {
+        SDL_Event event;
+
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                running = false;
+            } else {
+                std::lock_guard<std::mutex> lock(event_mutex);
+                events.push_back(event);
+            }
         }
+
+        presenter->show();
     }
 
+    // the drawing thread may be waiting for a frame that is never shown
+    presenter->close();
+    draw_thread.join();
+
     delete level;
+    delete presenter;
     delete context;
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "math/frustum.hpp"
+
+#include <cmath>
+
+frustum_t::frustum_t(const mat_t<float>& m, float width, float height) {
+    // clip space is inside for w >= 1, 0 <= x <= width * w and 0 <= y <= height * w,
+    // each condition is a linear combination of the rows of the matrix
+    const float rows[num_planes][4] = {
+        { m[12], m[13], m[14], m[15] - 1.0f },
+        { m[0], m[1], m[2], m[3] },
+        { width * m[12] - m[0], width * m[13] - m[1], width * m[14] - m[2], width * m[15] - m[3] },
+        { m[4], m[5], m[6], m[7] },
+        { height * m[12] - m[4], height * m[13] - m[5], height * m[14] - m[6], height * m[15] - m[7] }
+    };
+
+    for (int i = 0; i < num_planes; ++i) {
+        const float length = std::sqrt(rows[i][0] * rows[i][0] + rows[i][1] * rows[i][1] + rows[i][2] * rows[i][2]);
+        for (int k = 0; k < 4; ++k) {
+            m_planes[i][k] = rows[i][k] / length;
+        }
+    }
+}
+
+bool frustum_t::intersects(const sphere_t& sphere) const {
+    for (int i = 0; i < num_planes; ++i) {
+        const float * p = m_planes[i];
+        if (p[0] * sphere.center[0] + p[1] * sphere.center[1] + p[2] * sphere.center[2] + p[3] < -sphere.radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool frustum_t::intersects(const aabb_t& box) const {
+    for (int i = 0; i < num_planes; ++i) {
+        const float * p = m_planes[i];
+
+        // the corner furthest along the plane normal
+        const float x = p[0] >= 0 ? box.max[0] : box.min[0];
+        const float y = p[1] >= 0 ? box.max[1] : box.min[1];
+        const float z = p[2] >= 0 ? box.max[2] : box.min[2];
+
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,56 @@
+#include "math/points.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void transform_points(const mat_t<float>& t, const points_t& in, points_t& out, std::size_t first, std::size_t n) {
+    const float * in_x = in.x.data() + first;
+    const float * in_y = in.y.data() + first;
+    const float * in_z = in.z.data() + first;
+
+    float * out_x = out.x.data() + first;
+    float * out_y = out.y.data() + first;
+    float * out_z = out.z.data() + first;
+    float * out_w = out.w.data() + first;
+
+    std::size_t i = 0;
+
+#if defined(__AVX2__)
+    // one row of the matrix per output component, 8 points per iteration. a batch
+    // may start anywhere in the arrays, so the accesses are unaligned
+    const __m256 row[16] = {
+        _mm256_set1_ps(t[0]), _mm256_set1_ps(t[1]), _mm256_set1_ps(t[2]), _mm256_set1_ps(t[3]),
+        _mm256_set1_ps(t[4]), _mm256_set1_ps(t[5]), _mm256_set1_ps(t[6]), _mm256_set1_ps(t[7]),
+        _mm256_set1_ps(t[8]), _mm256_set1_ps(t[9]), _mm256_set1_ps(t[10]), _mm256_set1_ps(t[11]),
+        _mm256_set1_ps(t[12]), _mm256_set1_ps(t[13]), _mm256_set1_ps(t[14]), _mm256_set1_ps(t[15])
+    };
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256 x = _mm256_loadu_ps(in_x + i);
+        const __m256 y = _mm256_loadu_ps(in_y + i);
+        const __m256 z = _mm256_loadu_ps(in_z + i);
+
+        float * out_c[4] = { out_x, out_y, out_z, out_w };
+        for (int c = 0; c < 4; ++c) {
+            const __m256 * r = row + 4 * c;
+            __m256 value = _mm256_mul_ps(r[0], x);
+            value = _mm256_add_ps(value, _mm256_mul_ps(r[1], y));
+            value = _mm256_add_ps(value, _mm256_mul_ps(r[2], z));
+            value = _mm256_add_ps(value, r[3]);
+            _mm256_storeu_ps(out_c[c] + i, value);
+        }
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const float x = in_x[i];
+        const float y = in_y[i];
+        const float z = in_z[i];
+
+        out_x[i] = t[0]*x + t[1]*y + t[2]*z + t[3];
+        out_y[i] = t[4]*x + t[5]*y + t[6]*z + t[7];
+        out_z[i] = t[8]*x + t[9]*y + t[10]*z + t[11];
+        out_w[i] = t[12]*x + t[13]*y + t[14]*z + t[15];
+    }
+}
@@ -30,11 +30,16 @@ Model Cube::generate_cube_model(const std::string& texture) {
         1, 1
     };
 
-    return Model(positions, indices, tex_coords, Texture(texture));
+    return Model(positions, indices, tex_coords, Texture::load(texture));
 }
 
-Cube::Cube() : m_model(generate_cube_model("assets/cobblestone.png")) { }
-Cube::Cube(const std::string& texture) : m_model(generate_cube_model(texture)) { }
+Cube::Cube() : m_model(generate_cube_model("assets/cobblestone.png")) {
+    set_bound(m_model.get_bounding_sphere());
+}
+
+Cube::Cube(const std::string& texture) : m_model(generate_cube_model(texture)) {
+    set_bound(m_model.get_bounding_sphere());
+}
 
 void Cube::event(const SDL_Event & event) { }
 void Cube::update(Level & level, float delta_time) { }
@@ -1,6 +1,9 @@
 #include "world/entity.hpp"
 #include "math/transform.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 Entity::Entity() :
     m_position(0.0f),
     m_scale(1.0f),
@@ -28,6 +31,23 @@ const mat_t<float> & Entity::get_world() {
     return m_world;
 }
 
+bool Entity::has_bound() const {
+    return m_has_bound;
+}
+
+sphere_t Entity::get_world_bound() {
+    const vec_t<float> center = get_world() * m_bound.center;
+
+    // rotation keeps the radius, non uniform scale can only grow it by the largest axis
+    const float max_scale = std::max({std::fabs(m_scale[0]), std::fabs(m_scale[1]), std::fabs(m_scale[2])});
+    return sphere_t(center, m_bound.radius * max_scale);
+}
+
+void Entity::set_bound(const sphere_t & bound) {
+    m_bound = bound;
+    m_has_bound = true;
+}
+
 void Entity::set_position(const vec_t<float> & position) {
     m_position = position;
     m_recalculate_matrix = true;
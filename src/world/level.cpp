@@ -43,9 +43,15 @@ void Level::event(const SDL_Event& event) {
 
 void Level::render(GraphicsContext & context, const mat_t<float>& projection) {
 	mat_t<float> view_matrix = get_view_matrix();
+	const frustum_t frustum(projection * view_matrix, context.get_width(), context.get_height());
 
 	for (int i = 0; i < max_entities; ++i) {
 		if (m_entities[i]) {
+			// skip entities entirely outside the view before any per triangle work
+			if (m_entities[i]->has_bound() && !frustum.intersects(m_entities[i]->get_world_bound())) {
+				continue;
+			}
+
 			m_entities[i]->render(context, projection, view_matrix);
 		}
 	}
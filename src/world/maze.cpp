@@ -5,8 +5,13 @@
 #include <stdexcept>
 #include <stack>
 #include <random>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
-Maze::Maze(int width, int height)  : 
+Maze::Maze(int width, int height) : Maze(width, height, std::random_device()()) {}
+
+Maze::Maze(int width, int height, unsigned int seed) : 
 	m_player(add_entity<Player>()),
 	m_start_cube(add_entity<Cube>("assets/blue_wool.png")) {
 
@@ -17,7 +22,7 @@ Maze::Maze(int width, int height)  :
 		throw std::runtime_error("map size too small, minimum 4x4");
 	}
 
-	generate_maze();
+	generate_maze(seed);
 	generate_mesh();
 	initialize_world();
 }
@@ -58,8 +63,220 @@ void Maze::event(const SDL_Event& event) {
 void Maze::render(GraphicsContext & context, const mat_t<float> & projection) {
 	Level::render(context, projection);
 
-	m_floor_model->render(context, projection, get_view_matrix());
-	m_model->render(context, projection, get_view_matrix());
+	const float width = context.get_width();
+	const float height = context.get_height();
+
+	const mat_t<float> & view = get_view_matrix();
+	const mat_t<float> projection_view = projection * view;
+
+	find_visible_chunks(frustum_t(projection_view, width, height));
+
+	m_wall_groups.clear();
+	m_floor_groups.clear();
+
+	// walls are grouped in runs, only runs touching tiles seen through portals are drawn
+	if (find_visible_tiles(projection_view, width, height)) {
+		m_frame++;
+
+		for (unsigned int tile : m_visible_tiles) {
+			unsigned char & flags = m_chunk_flags[get_chunk(tile % m_width, tile / m_width)];
+			if (!(flags & chunk_in_view)) continue;
+
+			flags |= chunk_reached;
+
+			// a run spans several tiles, add it once
+			for (unsigned int i = m_tile_runs_first[tile]; i < m_tile_runs_first[tile + 1]; ++i) {
+				const unsigned int run = m_tile_runs[i];
+				if (m_run_stamps[run] != m_frame) {
+					m_run_stamps[run] = m_frame;
+					m_wall_groups.push_back(run);
+				}
+			}
+		}
+
+		// keep the draw order of the full mesh
+		std::sort(m_wall_groups.begin(), m_wall_groups.end());
+
+		for (unsigned int chunk : m_visible_chunks) {
+			if (m_chunk_flags[chunk] & chunk_reached) {
+				m_floor_groups.push_back(chunk);
+			}
+		}
+	} else {
+		// runs are stored chunk by chunk
+		for (unsigned int chunk : m_visible_chunks) {
+			for (unsigned int run = m_chunk_runs[chunk]; run < m_chunk_runs[chunk + 1]; ++run) {
+				m_wall_groups.push_back(run);
+			}
+		}
+
+		m_floor_groups = m_visible_chunks;
+	}
+
+	m_floor_model->render(context, projection, view, m_floor_groups);
+	m_model->render(context, projection, view, m_wall_groups);
+}
+
+void Maze::find_visible_chunks(const frustum_t & frustum) {
+	const vec_t<float> & eye = get_camera_eye();
+	const float max_distance = m_draw_distance * m_draw_distance;
+
+	m_visible_chunks.clear();
+
+	for (unsigned int chunk = 0; chunk < m_chunk_bounds.size(); ++chunk) {
+		const aabb_t & bounds = m_chunk_bounds[chunk];
+		unsigned char flags = 0;
+
+		// distance from the eye to the closest point of the chunk
+		const float dx = std::max({ bounds.min[0] - eye[0], 0.0f, eye[0] - bounds.max[0] });
+		const float dy = std::max({ bounds.min[1] - eye[1], 0.0f, eye[1] - bounds.max[1] });
+		const float dz = std::max({ bounds.min[2] - eye[2], 0.0f, eye[2] - bounds.max[2] });
+
+		if (m_draw_distance <= 0.0f || dx * dx + dy * dy + dz * dz <= max_distance) {
+			flags |= chunk_in_range;
+
+			if (frustum.intersects(bounds)) {
+				flags |= chunk_in_view;
+				m_visible_chunks.push_back(chunk);
+			}
+		}
+
+		m_chunk_flags[chunk] = flags;
+	}
+}
+
+bool Maze::find_visible_tiles(const mat_t<float> & projection_view, float width, float height) {
+	// forget the tiles reached last frame
+	for (unsigned int tile : m_visible_tiles) {
+		m_tile_rects[tile] = screen_rect_t();
+	}
+
+	m_visible_tiles.clear();
+
+	const vec_t<float> & eye = get_camera_eye();
+	const int eye_x = std::floor(eye[0] / tile_width);
+	const int eye_y = std::floor(eye[2] / tile_width);
+
+	// from inside a wall the back faces let the view through in any direction, so
+	// there is nothing to traverse from
+	if (eye_x < 0 || eye_x >= m_width || eye_y < 0 || eye_y >= m_height) return false;
+	if (m_map_buffer[get_index(map_square_pos_t(eye_x, eye_y))] == wall) return false;
+
+	const unsigned int start = get_index(map_square_pos_t(eye_x, eye_y));
+	m_tile_rects[start] = screen_rect_t(0.0f, 0.0f, width, height);
+	m_visible_tiles.push_back(start);
+
+	// a tile is revisited whenever the rectangle it is seen through grows, the
+	// rectangles are built from a finite set of portal edges so this terminates
+	m_tile_stack.clear();
+	m_tile_stack.push_back(start);
+	m_tile_queued[start] = true;
+
+	static const int offsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+	while (!m_tile_stack.empty()) {
+		const unsigned int tile = m_tile_stack.back();
+		m_tile_stack.pop_back();
+		m_tile_queued[tile] = false;
+
+		const int x = tile % m_width;
+		const int y = tile / m_width;
+
+		for (const auto & offset : offsets) {
+			const map_square_pos_t next_pos(x + offset[0], y + offset[1]);
+			if (next_pos.x < 0 || next_pos.x >= m_width || next_pos.y < 0 || next_pos.y >= m_height) continue;
+
+			const unsigned int next = get_index(next_pos);
+			if (m_map_buffer[next] == wall) continue;
+
+			// a tile out of range can not lead to anything closer
+			if (!(m_chunk_flags[get_chunk(next_pos.x, next_pos.y)] & chunk_in_range)) continue;
+
+			// the shared edge of the two tiles
+			float x0, z0, x1, z1;
+			if (offset[0] != 0) {
+				x0 = x1 = std::max(x, next_pos.x) * tile_width;
+				z0 = y * tile_width;
+				z1 = z0 + tile_width;
+			} else {
+				z0 = z1 = std::max(y, next_pos.y) * tile_width;
+				x0 = x * tile_width;
+				x1 = x0 + tile_width;
+			}
+
+			screen_rect_t rect;
+			if (!project_portal(projection_view, x0, z0, x1, z1, m_tile_rects[tile], rect)) continue;
+
+			screen_rect_t & next_rect = m_tile_rects[next];
+			if (next_rect.min_x >= next_rect.max_x) {
+				next_rect = rect;
+				m_visible_tiles.push_back(next);
+			} else if (rect.min_x >= next_rect.min_x && rect.max_x <= next_rect.max_x && rect.min_y >= next_rect.min_y && rect.max_y <= next_rect.max_y) {
+				continue;
+			} else {
+				next_rect = screen_rect_t(
+					std::min(rect.min_x, next_rect.min_x), std::min(rect.min_y, next_rect.min_y),
+					std::max(rect.max_x, next_rect.max_x), std::max(rect.max_y, next_rect.max_y)
+				);
+			}
+
+			if (!m_tile_queued[next]) {
+				m_tile_queued[next] = true;
+				m_tile_stack.push_back(next);
+			}
+		}
+	}
+
+	// keep the draw order of the full mesh
+	std::sort(m_visible_tiles.begin(), m_visible_tiles.end());
+	return true;
+}
+
+inline bool Maze::project_portal(const mat_t<float> & m, float x0, float z0, float x1, float z1, const screen_rect_t & parent, screen_rect_t & out) {
+	const float corners[4][3] = {
+		{ x0, 0.0f, z0 }, { x1, 0.0f, z1 },
+		{ x0, tile_height, z0 }, { x1, tile_height, z1 }
+	};
+
+	float min_x = std::numeric_limits<float>::max(), min_y = std::numeric_limits<float>::max();
+	float max_x = -std::numeric_limits<float>::max(), max_y = -std::numeric_limits<float>::max();
+
+	int behind = 0;
+	bool near_plane = false;
+
+	for (const auto & c : corners) {
+		const float w = m[12] * c[0] + m[13] * c[1] + m[14] * c[2] + m[15];
+
+		if (w <= 0.0f) behind++;
+		if (w <= 1.0f) {
+			near_plane = true;
+			continue;
+		}
+
+		const float x = (m[0] * c[0] + m[1] * c[1] + m[2] * c[2] + m[3]) / w;
+		const float y = (m[4] * c[0] + m[5] * c[1] + m[6] * c[2] + m[7]) / w;
+
+		min_x = std::min(min_x, x);
+		min_y = std::min(min_y, y);
+		max_x = std::max(max_x, x);
+		max_y = std::max(max_y, y);
+	}
+
+	// nothing behind the eye can be seen through the portal
+	if (behind == 4) return false;
+
+	// a portal crossing the near plane can be looked through at any angle
+	if (near_plane) {
+		out = parent;
+		return true;
+	}
+
+	out = screen_rect_t(
+		std::max(parent.min_x, min_x), std::max(parent.min_y, min_y),
+		std::min(parent.max_x, max_x), std::min(parent.max_y, max_y)
+	);
+
+	return out.min_x < out.max_x && out.min_y < out.max_y;
 }
 
 void Maze::update(float delta_time) {
@@ -82,6 +299,10 @@ inline unsigned int Maze::get_index(const map_square_pos_t & pos) {
 	return (pos.y * m_width) + pos.x;
 }
 
+inline unsigned int Maze::get_chunk(int x, int y) {
+	return (y / chunk_size) * m_chunks_x + (x / chunk_size);
+}
+
 bool Maze::can_move(const vec_t<float>& position) {
 	float x = position[0];
 	float y = position[2];
@@ -97,14 +318,21 @@ vec_t<float> Maze::get_tile_pos(int x, int y) {
 	return vec_t<float>(x * tile_width, 0.0f, y * tile_width);
 }
 
+void Maze::set_draw_distance(float distance) {
+	m_draw_distance = distance;
+}
+
+float Maze::get_draw_distance() const {
+	return m_draw_distance;
+}
+
 vec_t<float> Maze::get_start_pos() {
 	return vec_t<float>(1.5f * tile_width, 0.0f, 1.5f * tile_width);
 }
 
-void Maze::generate_maze() {
-	// c++ random gen
-	std::random_device dev;
-	std::mt19937 rng(dev());
+void Maze::generate_maze(unsigned int seed) {
+	// the same seed always carves the same maze
+	std::mt19937 rng(seed);
 
 	std::stack<map_square_pos_t> stack; 
 	map_square_pos_t curr = map_square_pos_t(1, m_height - 2);
@@ -156,93 +384,179 @@ void Maze::generate_mesh() {
 	const float th = tile_width; // tile height
 	const float wh = tile_height; // wall height
 
-	for (int i = 0, j = 0; i < m_map_buffer.size(); ++i) {
-		int square_x = i % m_width;
-		int square_y = i / m_width;
-
-		float tx = square_x * tw;
-		float ty = square_y * th;
-
-		if (m_map_buffer[i] == empty) {
-			std::vector<float> positions = {
-				tx, 	 0.0f, ty + th,
-				tx + tw, 0.0f, ty + th,
-				tx, 	 0.0f, ty,
-				tx + tw, 0.0f, ty,
-
-				// top vertices
-				tx, 	 wh,   ty + th,
-				tx + tw, wh,   ty + th,
-				tx, 	 wh,   ty,
-				tx + tw, wh,   ty
-			};
-
-			std::vector<float> tex_coords = {
-				1.0f, 0.0f,
-				0.0f, 1.0f,
-				1.0f, 1.0f,
-				1.0f, 0.0f,
-				0.0f, 0.0f,
-				0.0f, 1.0f
-			};
-
-			std::vector<unsigned int> indices;
-
-			if (m_map_buffer[i + m_width] == wall) { // top wall
-				indices.insert(indices.end(), { 5, 0, 1, 5, 4, 0 });
-				mesh_tex_coords.insert(mesh_tex_coords.end(), tex_coords.begin(), tex_coords.end());
-			}
+	m_chunks_x = (m_width + chunk_size - 1) / chunk_size;
+	m_chunks_y = (m_height + chunk_size - 1) / chunk_size;
 
-			if (m_map_buffer[i - 1] == wall) { // left wall
-				indices.insert(indices.end(), { 4, 2, 0, 4, 6, 2 });
-				mesh_tex_coords.insert(mesh_tex_coords.end(), tex_coords.begin(), tex_coords.end());
-			}
+	const unsigned int num_chunks = m_chunks_x * m_chunks_y;
 
-			if (m_map_buffer[i - m_width] == wall) { // bottom wall
-				indices.insert(indices.end(), { 6, 3, 2, 6, 7, 3 });
-				mesh_tex_coords.insert(mesh_tex_coords.end(), tex_coords.begin(), tex_coords.end());
-			}
+	// wall faces are merged into runs along rows and columns of a chunk, every
+	// run is a single quad and a group of the wall model. runs stay inside their
+	// chunk so chunk culling still applies, and every tile remembers the runs it
+	// is part of for portal culling
+	std::vector<std::vector<unsigned int>> tile_runs(m_map_buffer.size());
+	m_chunk_runs.assign(num_chunks + 1, 0);
+	unsigned int num_runs = 0;
 
-			if (m_map_buffer[i + 1] == wall) { // right wall
-				indices.insert(indices.end(), { 7, 1, 3, 7, 5, 1 });
-				mesh_tex_coords.insert(mesh_tex_coords.end(), tex_coords.begin(), tex_coords.end());
-			}
+	// does the tile have a wall face towards the neighbor at (x + dx, y + dy), the
+	// outside of the map counts as wall
+	auto has_face = [&](int x, int y, int dx, int dy) {
+		if (m_map_buffer[get_index(map_square_pos_t(x, y))] != empty) return false;
+
+		const int nx = x + dx, ny = y + dy;
+		if (nx < 0 || nx >= m_width || ny < 0 || ny >= m_height) return true;
+
+		return m_map_buffer[get_index(map_square_pos_t(nx, ny))] == wall;
+	};
 
-			for (int k = 0; k < indices.size(); ++k) {
-				indices[k] = (j * 8) + indices[k];
+	// a wall quad from (sx, sz) to (ex, ez) seen with the start on the left,
+	// u goes from 0 to the length of the run in tiles so the texture repeats per tile
+	auto add_run = [&](float sx, float sz, float ex, float ez, float length) {
+		const unsigned int base = mesh_positions.size() / 3;
+
+		mesh_positions.insert(mesh_positions.end(), {
+			sx, 0.0f, sz,
+			ex, 0.0f, ez,
+			sx, wh,   sz,
+			ex, wh,   ez
+		});
+
+		mesh_indices.insert(mesh_indices.end(), { base + 3, base + 0, base + 1, base + 3, base + 2, base + 0 });
+
+		mesh_tex_coords.insert(mesh_tex_coords.end(), {
+			length, 0.0f,
+			0.0f,   1.0f,
+			length, 1.0f,
+			length, 0.0f,
+			0.0f,   0.0f,
+			0.0f,   1.0f
+		});
+	};
+
+	for (int cy = 0; cy < m_chunks_y; ++cy) {
+		for (int cx = 0; cx < m_chunks_x; ++cx) {
+			const int x0 = cx * chunk_size, x1 = std::min((cx + 1) * chunk_size, m_width);
+			const int y0 = cy * chunk_size, y1 = std::min((cy + 1) * chunk_size, m_height);
+
+			// faces towards walls at y + 1 and y - 1 run along x
+			for (int y = y0; y < y1; ++y) {
+				for (int side = 1; side >= -1; side -= 2) {
+					for (int x = x0; x < x1;) {
+						if (!has_face(x, y, 0, side)) {
+							++x;
+							continue;
+						}
+
+						int end = x + 1;
+						while (end < x1 && has_face(end, y, 0, side)) ++end;
+
+						if (side > 0) {
+							add_run(x * tw, (y + 1) * th, end * tw, (y + 1) * th, end - x);
+						} else {
+							add_run(end * tw, y * th, x * tw, y * th, end - x);
+						}
+
+						for (int k = x; k < end; ++k) {
+							tile_runs[get_index(map_square_pos_t(k, y))].push_back(num_runs);
+						}
+
+						num_runs++;
+						x = end;
+					}
+				}
 			}
 
-			mesh_positions.insert(mesh_positions.end(), positions.begin(), positions.end());
-			mesh_indices.insert(mesh_indices.end(), indices.begin(), indices.end());
+			// faces towards walls at x - 1 and x + 1 run along z
+			for (int x = x0; x < x1; ++x) {
+				for (int side = -1; side <= 1; side += 2) {
+					for (int y = y0; y < y1;) {
+						if (!has_face(x, y, side, 0)) {
+							++y;
+							continue;
+						}
+
+						int end = y + 1;
+						while (end < y1 && has_face(x, end, side, 0)) ++end;
+
+						if (side < 0) {
+							add_run(x * tw, y * th, x * tw, end * th, end - y);
+						} else {
+							add_run((x + 1) * tw, end * th, (x + 1) * tw, y * th, end - y);
+						}
+
+						for (int k = y; k < end; ++k) {
+							tile_runs[get_index(map_square_pos_t(x, k))].push_back(num_runs);
+						}
+
+						num_runs++;
+						y = end;
+					}
+				}
+			}
 
-			j = j + 1;
+			m_chunk_runs[cy * m_chunks_x + cx + 1] = num_runs;
 		}
 	}
 
-	m_model = std::make_unique<Model>(mesh_positions, mesh_indices, mesh_tex_coords, Texture("assets/bricks.png"));
-
-	std::vector<float> floor_positions = {
-		0.0f, 0.0f, 0.0f,
-		m_width * tw, 0.0f, 0.0f,
-		m_width * tw, 0.0f, m_height * th,
-		0.0f, 0.0f, m_height * th
-	};
+	// flatten the runs of every tile
+	m_tile_runs_first.assign(m_map_buffer.size() + 1, 0);
+	m_tile_runs.clear();
 
-	std::vector<unsigned int> floor_indices = {
-		0, 1, 2, 
-		0, 2, 3
-	};
+	for (unsigned int i = 0; i < tile_runs.size(); ++i) {
+		m_tile_runs.insert(m_tile_runs.end(), tile_runs[i].begin(), tile_runs[i].end());
+		m_tile_runs_first[i + 1] = m_tile_runs.size();
+	}
 
-	std::vector<float> floor_tex_coords = {
-		0.0f, 0.0f,
-		m_width * 1.0f, 0.0f,
-		m_width * 1.0f, m_height * 1.0f,
-		0.0f, 0.0f,
-		m_width * 1.0f, m_height * 1.0f,
-		0.0f, m_height * 1.0f
-	};
+	m_run_stamps.assign(num_runs, 0);
+	m_frame = 0;
+
+	m_model = std::make_unique<Model>(mesh_positions, mesh_indices, mesh_tex_coords, Texture::load("assets/bricks.png"), std::vector<unsigned int>(num_runs, 2));
+
+	m_tile_rects.assign(m_map_buffer.size(), screen_rect_t());
+	m_tile_queued.assign(m_map_buffer.size(), false);
+	m_visible_tiles.clear();
+
+	// the floor is one quad per chunk, texture coordinates are in tiles so the
+	// texture repeats once per tile across chunk borders
+	std::vector<float> floor_positions;
+	std::vector<float> floor_tex_coords;
+	std::vector<unsigned int> floor_indices;
+	std::vector<unsigned int> floor_groups(num_chunks, 2);
+
+	m_chunk_bounds.resize(num_chunks);
+	m_chunk_flags.assign(num_chunks, 0);
+
+	for (int cy = 0; cy < m_chunks_y; ++cy) {
+		for (int cx = 0; cx < m_chunks_x; ++cx) {
+			const float x0 = cx * chunk_size, x1 = std::min((cx + 1) * chunk_size, m_width);
+			const float y0 = cy * chunk_size, y1 = std::min((cy + 1) * chunk_size, m_height);
+			const unsigned int base = floor_positions.size() / 3;
+
+			floor_positions.insert(floor_positions.end(), {
+				x0 * tw, 0.0f, y0 * th,
+				x1 * tw, 0.0f, y0 * th,
+				x1 * tw, 0.0f, y1 * th,
+				x0 * tw, 0.0f, y1 * th
+			});
+
+			floor_indices.insert(floor_indices.end(), {
+				base + 0, base + 1, base + 2,
+				base + 0, base + 2, base + 3
+			});
+
+			floor_tex_coords.insert(floor_tex_coords.end(), {
+				x0, y0,
+				x1, y0,
+				x1, y1,
+				x0, y0,
+				x1, y1,
+				x0, y1
+			});
+
+			m_chunk_bounds[cy * m_chunks_x + cx] = aabb_t(vec_t<float>(x0 * tw, 0.0f, y0 * th), vec_t<float>(x1 * tw, wh, y1 * th));
+		}
+	}
 
-	m_floor_model = std::make_unique<Model>(floor_positions, floor_indices, floor_tex_coords, Texture("assets/oak_planks.png"));
+	m_floor_model = std::make_unique<Model>(floor_positions, floor_indices, floor_tex_coords, Texture::load("assets/oak_planks.png"), floor_groups);
 }
 
 std::ostream & operator<<(std::ostream & stream, const Maze & maze) {
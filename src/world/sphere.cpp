@@ -129,11 +129,16 @@ Model Sphere::generate_sphere_model(const std::string& texture) {
         }
     }
 
-    return Model(positions, indices, tex_coords, Texture(texture));
+    return Model(positions, indices, tex_coords, Texture::load(texture));
 }
 
-Sphere::Sphere() : m_model(generate_sphere_model("assets/texture.png")) { }
-Sphere::Sphere(const std::string& texture) : m_model(generate_sphere_model(texture)) { }
+Sphere::Sphere() : m_model(generate_sphere_model("assets/texture.png")) {
+    set_bound(m_model.get_bounding_sphere());
+}
+
+Sphere::Sphere(const std::string& texture) : m_model(generate_sphere_model(texture)) {
+    set_bound(m_model.get_bounding_sphere());
+}
 
 void Sphere::event(const SDL_Event & event) { }
 void Sphere::update(Level & level, float delta_time) { }